@@ -8,5 +8,8 @@ return {
   },
   autoupdate = {
     enable = false
+  },
+  watcher = {
+    interval = 5
   }
 }
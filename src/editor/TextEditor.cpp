@@ -227,6 +227,23 @@ void TextEditor::load(const QString &path, const QString &text)
   updateGeometry();
 }
 
+void TextEditor::reset()
+{
+  setReadOnly(false);
+  clearAll();
+  markerDeleteAll(-1);
+  marginTextClearAll();
+  annotationClearAll();
+  clearHighlights();
+
+  mDiagnostics.clear();
+  for (int i = 0; i <= SC_MAX_MARGIN; ++i)
+    setMarginWidthN(i, 0);
+
+  setXOffset(0);
+  setScrollWidth(256);
+}
+
 void TextEditor::clearHighlights()
 {
   setIndicatorCurrent(FindAll);
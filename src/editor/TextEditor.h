@@ -89,6 +89,9 @@ public:
   void setLexer(const QString &path);
   void load(const QString &path, const QString &text);
 
+  // Clear content, markers, highlights and diagnostics for reuse.
+  void reset();
+
   void clearHighlights();
   int highlightAll(const QString &text);
   int find(const QString &text, bool forward = true, bool indicator = true);
@@ -0,0 +1,135 @@
+//
+//          Copyright (c) 2016, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#include "BloomFilter.h"
+#include <QSet>
+
+namespace git {
+
+namespace {
+
+const int kHashCount = 7;
+const int kBitsPerEntry = 10;
+const int kMaxChangedPaths = 512;
+
+const quint32 kSeed0 = 0x293ae76f;
+const quint32 kSeed1 = 0x7e646e2c;
+
+quint32 rotl(quint32 value, int count)
+{
+  return (value << count) | (value >> (32 - count));
+}
+
+quint32 murmur3(quint32 seed, const QByteArray &data)
+{
+  const quint32 c1 = 0xcc9e2d51;
+  const quint32 c2 = 0x1b873593;
+
+  const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+  int len = data.length();
+  int blocks = len / 4;
+  for (int i = 0; i < blocks; ++i) {
+    const uchar *block = bytes + (4 * i);
+    quint32 k = block[0] | (block[1] << 8) | (block[2] << 16) |
+                (quint32(block[3]) << 24);
+    k *= c1;
+    k = rotl(k, 15);
+    k *= c2;
+
+    seed ^= k;
+    seed = rotl(seed, 13) * 5 + 0xe6546b64;
+  }
+
+  quint32 k = 0;
+  const uchar *tail = bytes + (4 * blocks);
+  switch (len & 3) {
+    case 3:
+      k ^= tail[2] << 16;
+      // fall through
+    case 2:
+      k ^= tail[1] << 8;
+      // fall through
+    case 1:
+      k ^= tail[0];
+      k *= c1;
+      k = rotl(k, 15);
+      k *= c2;
+      seed ^= k;
+      break;
+  }
+
+  seed ^= quint32(len);
+  seed ^= (seed >> 16);
+  seed *= 0x85ebca6b;
+  seed ^= (seed >> 13);
+  seed *= 0xc2b2ae35;
+  seed ^= (seed >> 16);
+  return seed;
+}
+
+template <typename Func>
+void forEachBit(const QByteArray &path, int bits, Func func)
+{
+  quint32 h0 = murmur3(kSeed0, path);
+  quint32 h1 = murmur3(kSeed1, path);
+  for (int i = 0; i < kHashCount; ++i) {
+    quint32 pos = (h0 + i * h1) % bits;
+    func(pos / 8, uchar(1 << (pos & 7)));
+  }
+}
+
+} // anon. namespace
+
+BloomFilter::BloomFilter(const QByteArray &data)
+  : d(data)
+{}
+
+bool BloomFilter::contains(const QByteArray &path) const
+{
+  if (!isValid())
+    return true;
+
+  bool result = true;
+  forEachBit(path, d.length() * 8, [this, &result](int byte, uchar mask) {
+    if (!(d.at(byte) & mask))
+      result = false;
+  });
+
+  return result;
+}
+
+BloomFilter BloomFilter::create(const QList<QByteArray> &paths)
+{
+  // Add leading directories.
+  QSet<QByteArray> keys;
+  foreach (const QByteArray &path, paths) {
+    int index = path.length();
+    while (index > 0) {
+      keys.insert(path.left(index));
+      index = path.lastIndexOf('/', index - 1);
+    }
+  }
+
+  // Too many changes to be useful. Always match.
+  if (keys.size() > kMaxChangedPaths)
+    return BloomFilter(QByteArray(1, char(0xff)));
+
+  // An empty filter still has one byte so that it's valid.
+  int len = qMax(1, (keys.size() * kBitsPerEntry + 7) / 8);
+  QByteArray data(len, 0);
+  foreach (const QByteArray &key, keys) {
+    forEachBit(key, len * 8, [&data](int byte, uchar mask) {
+      data[byte] = data.at(byte) | mask;
+    });
+  }
+
+  return BloomFilter(data);
+}
+
+} // namespace git
@@ -0,0 +1,41 @@
+//
+//          Copyright (c) 2016, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <QByteArray>
+#include <QList>
+
+namespace git {
+
+// A changed-path Bloom filter for a single commit. Hashing follows git's
+// commit-graph BDAT chunk (murmur3, seven hashes, ten bits per entry) and
+// each path also adds its leading directories.
+class BloomFilter
+{
+public:
+  BloomFilter(const QByteArray &data = QByteArray());
+
+  bool isValid() const { return !d.isEmpty(); }
+
+  // Return false if the path definitely didn't change.
+  bool contains(const QByteArray &path) const;
+
+  QByteArray data() const { return d; }
+
+  static BloomFilter create(const QList<QByteArray> &paths);
+
+private:
+  QByteArray d;
+};
+
+} // namespace git
+
+#endif
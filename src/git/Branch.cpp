@@ -116,6 +116,8 @@ Branch Branch::rename(const QString &name)
   if (git_branch_move(&ref, d.data(), name.toUtf8(), false))
     return Branch();
 
+  repo().invalidateRefCache();
+
   // Invalidate this branch.
   d.clear();
   return Branch(ref);
@@ -19,19 +19,50 @@
 #include "conf/Settings.h"
 #include "git2/annotated_commit.h"
 #include "git2/diff.h"
-#include "git2/refs.h"
 #include "git2/revert.h"
 #include <QDateTime>
+#include <QFile>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QRegularExpression>
 #include <QTextCodec>
 #include <QVector>
 
 namespace git {
 
-QMap<QString,QString> Commit::sEmojiCache;
+namespace {
+
+// Map emoji aliases (e.g. "smile") to emoji. The table is loaded once.
+const QHash<QString,QString> &emojiAliases()
+{
+  static const QHash<QString,QString> aliases = [] {
+    QHash<QString,QString> aliases;
+    QFile file(Settings::confDir().filePath("emoji.json"));
+    if (file.open(QFile::ReadOnly)) {
+      QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+      for (const QJsonValue &val : doc.array()) {
+        QJsonObject obj = val.toObject();
+        QString emoji = obj.value("emoji").toString();
+        if (!emoji.isEmpty()) {
+          for (const QJsonValue &alias : obj.value("aliases").toArray())
+            aliases.insert(alias.toString(), emoji);
+        }
+      }
+    }
+
+    return aliases;
+  }();
+
+  return aliases;
+}
+
+bool isShortcodeChar(const QChar &ch)
+{
+  return (ch.isLetterOrNumber() || ch == '_' || ch == '+' || ch == '-');
+}
+
+} // anon. namespace
 
 Commit::Commit()
   : Object()
@@ -71,38 +102,14 @@ QString Commit::message(MessageOptions options) const
 
 QString Commit::description() const
 {
-  // Build list of candidates.
-  QHash<Id,TagRef> candidates;
-  foreach (const TagRef &tag, repo().tags()) {
-    if (Commit commit = tag.target())
-      candidates.insert(commit.id(), tag);
-  }
-
-  if (candidates.isEmpty())
+  Repository::Description description = repo().describe(*this);
+  if (description.distance < 0)
     return QString();
 
-  // Check for exact match.
-  auto it = candidates.constFind(id());
-  if (it != candidates.constEnd())
-    return it->name();
-
-  // Walk parents.
-  QList<Commit> commits = parents();
-  while (!commits.isEmpty()) {
-    QSet<Commit> parents;
-    foreach (const Commit &commit, commits) {
-      auto it = candidates.constFind(commit.id());
-      if (it != candidates.constEnd())
-        return QString("%1 +%2").arg(it->name()).arg(difference(commit));
-
-      foreach (const Commit &parent, commit.parents())
-        parents.insert(parent);
-    }
-
-    commits = parents.values();
-  }
+  if (!description.distance)
+    return description.tag;
 
-  return QString();
+  return QString("%1 +%2").arg(description.tag).arg(description.count);
 }
 
 QString Commit::detachedHeadName() const
@@ -133,7 +140,10 @@ Signature Commit::committer() const
   return const_cast<git_signature *>(git_commit_committer(*this));
 }
 
-Diff Commit::diff(const git::Commit &commit, int contextLines) const
+Diff Commit::diff(
+  const git::Commit &commit,
+  int contextLines,
+  Diff::Callbacks *callbacks) const
 {
   Tree old;
   if (commit.isValid()) {
@@ -149,6 +159,11 @@ Diff Commit::diff(const git::Commit &commit, int contextLines) const
   if (Settings::instance()->isWhitespaceIgnored())
     opts.flags |= GIT_DIFF_IGNORE_WHITESPACE;
 
+  if (callbacks) {
+    opts.progress_cb = &Diff::Callbacks::progress;
+    opts.payload = callbacks;
+  }
+
   git_diff *diff = nullptr;
   git_repository *repo = git_object_owner(d.data());
   git_diff_tree_to_tree(&diff, repo, old, tree(), &opts);
@@ -188,27 +203,7 @@ QList<Reference> Commit::refs() const
       refs.append(head);
   }
 
-  // Iterate over references.
-  git_reference_iterator *it = nullptr;
-  if (git_reference_iterator_new(&it, repo))
-    return QList<Reference>();
-
-  git_reference *ref = nullptr;
-  const git_oid *id = git_object_id(d.data());
-  while (!git_reference_next(&ref, it)) {
-    git_object *obj = nullptr;
-    if (!git_reference_peel(&obj, ref, GIT_OBJECT_COMMIT) &&
-        git_oid_equal(git_object_id(obj), id)) {
-      refs.append(Reference(ref));
-    } else {
-      git_reference_free(ref);
-    }
-
-    git_object_free(obj);
-  }
-
-  git_reference_iterator_free(it);
-
+  refs.append(repo.lookupRefs(id()));
   return refs;
 }
 
@@ -218,7 +213,7 @@ RevWalk Commit::walker(int sort) const
   if (git_revwalk_new(&revwalk, git_object_owner(d.data())))
     return RevWalk();
 
-  RevWalk walker(revwalk);
+  RevWalk walker(revwalk, repo());
   if (git_revwalk_push(revwalk, git_object_id(d.data())))
     return RevWalk();
 
@@ -308,37 +303,50 @@ QString Commit::decodeMessage(const char *msg) const
 
 QString Commit::substituteEmoji(const QString &text) const
 {
-  // Populate cache.
-  if (sEmojiCache.isEmpty()) {
-    QFile file(Settings::confDir().filePath("emoji.json"));
-    if (file.open(QFile::ReadOnly)) {
-      QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-      for (const QJsonValue &val : doc.array()) {
-        QJsonObject obj = val.toObject();
-        QString emoji = obj.value("emoji").toString();
-        if (!emoji.isEmpty()) {
-          for (const QJsonValue &alias : obj.value("aliases").toArray())
-            sEmojiCache[alias.toString()] = emoji;
-        }
-      }
+  // Return the text unchanged without any shortcodes.
+  int start = text.indexOf(':');
+  if (start < 0)
+    return text;
+
+  const QHash<QString,QString> &aliases = emojiAliases();
+
+  // Scan for :alias: in a single pass.
+  QString result;
+  int last = 0;
+  int length = text.length();
+  while (start >= 0) {
+    int end = start + 1;
+    while (end < length && isShortcodeChar(text.at(end)))
+      ++end;
+
+    if (end >= length)
+      break;
+
+    if (text.at(end) != ':') {
+      start = text.indexOf(':', end);
+      continue;
     }
-  }
 
-  // Build list of matches.
-  QList<QRegularExpressionMatch> matches;
-  QRegularExpression re(":((\\w|_)+):");
-  QRegularExpressionMatchIterator it = re.globalMatch(text);
-  while (it.hasNext())
-    matches.prepend(it.next());
-
-  // Substitute in reverse order.
-  QString result = text;
-  foreach (const QRegularExpressionMatch &match, matches) {
-    auto it = sEmojiCache.constFind(match.captured(1));
-    if (it != sEmojiCache.constEnd())
-      result.replace(match.capturedStart(), match.capturedLength(), it.value());
+    auto it = aliases.constEnd();
+    if (end > start + 1)
+      it = aliases.constFind(text.mid(start + 1, end - start - 1));
+
+    if (it == aliases.constEnd()) {
+      // The closing colon may start the next shortcode.
+      start = end;
+      continue;
+    }
+
+    result.append(text.midRef(last, start - last));
+    result.append(it.value());
+    last = end + 1;
+    start = text.indexOf(':', last);
   }
 
+  if (!last)
+    return text;
+
+  result.append(text.midRef(last));
   return result;
 }
 
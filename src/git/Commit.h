@@ -10,6 +10,7 @@
 #ifndef COMMIT_H
 #define COMMIT_H
 
+#include "Diff.h"
 #include "Object.h"
 #include "git2/commit.h"
 #include "git2/revwalk.h"
@@ -20,7 +21,6 @@ class QDateTime;
 namespace git {
 
 class AnnotatedCommit;
-class Diff;
 class Reference;
 class RevWalk;
 class Signature;
@@ -51,7 +51,10 @@ public:
   Signature author() const;
   Signature committer() const;
 
-  Diff diff(const Commit &commit = git::Commit(), int contextLines = -1) const;
+  Diff diff(
+    const Commit &commit = git::Commit(),
+    int contextLines = -1,
+    Diff::Callbacks *callbacks = nullptr) const;
   Tree tree() const;
   QList<Commit> parents() const;
 
@@ -87,8 +90,6 @@ private:
   QString decodeMessage(const char *msg) const;
   QString substituteEmoji(const QString &text) const;
 
-  static QMap<QString,QString> sEmojiCache;
-
   friend class Blame;
   friend class AnnotatedCommit;
   friend class Rebase;
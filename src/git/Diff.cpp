@@ -9,11 +9,103 @@
 
 #include "Diff.h"
 #include "Patch.h"
+#include "git2/errors.h"
 #include "git2/patch.h"
+#include "git2/sys/hashsig.h"
+#include <QElapsedTimer>
 #include <algorithm>
 
 namespace git {
 
+namespace {
+
+// Match the default metric.
+const git_hashsig_option_t kHashsigOptions = GIT_HASHSIG_SMART_WHITESPACE;
+
+// Wrap the default similarity metric to check the callbacks and timeout.
+class Similarity
+{
+public:
+  Similarity(Diff::Callbacks *callbacks, int timeout)
+    : mCallbacks(callbacks), mTimeout(timeout)
+  {
+    mTimer.start();
+  }
+
+  static int fileSignature(
+    void **out,
+    const git_diff_file *file,
+    const char *path,
+    void *payload)
+  {
+    Similarity *similarity = reinterpret_cast<Similarity *>(payload);
+    if (!similarity->proceed(file->path))
+      return GIT_EUSER;
+
+    int error = git_hashsig_create_fromfile(
+      reinterpret_cast<git_hashsig **>(out), path, kHashsigOptions);
+    return similarity->check(error);
+  }
+
+  static int bufferSignature(
+    void **out,
+    const git_diff_file *file,
+    const char *buf,
+    size_t len,
+    void *payload)
+  {
+    Similarity *similarity = reinterpret_cast<Similarity *>(payload);
+    if (!similarity->proceed(file->path))
+      return GIT_EUSER;
+
+    int error = git_hashsig_create(
+      reinterpret_cast<git_hashsig **>(out), buf, len, kHashsigOptions);
+    return similarity->check(error);
+  }
+
+  static void freeSignature(void *sig, void *payload)
+  {
+    git_hashsig_free(reinterpret_cast<git_hashsig *>(sig));
+  }
+
+  static int compare(int *score, void *lhs, void *rhs, void *payload)
+  {
+    Similarity *similarity = reinterpret_cast<Similarity *>(payload);
+    if (!similarity->proceed())
+      return GIT_EUSER;
+
+    *score = git_hashsig_compare(
+      reinterpret_cast<git_hashsig *>(lhs),
+      reinterpret_cast<git_hashsig *>(rhs));
+    return (*score < 0) ? -1 : 0;
+  }
+
+private:
+  bool proceed(const char *path = nullptr)
+  {
+    if (mTimeout >= 0 && mTimer.elapsed() > mTimeout)
+      return false;
+
+    return !mCallbacks || mCallbacks->progress(path, path);
+  }
+
+  int check(int error)
+  {
+    // Files that are too small don't get a signature.
+    if (error != GIT_EBUFS)
+      return error;
+
+    git_error_clear();
+    return 0;
+  }
+
+  Diff::Callbacks *mCallbacks;
+  QElapsedTimer mTimer;
+  int mTimeout;
+};
+
+} // anon. namespace
+
 int Diff::Callbacks::progress(
   const git_diff *diff,
   const char *oldPath,
@@ -87,18 +179,21 @@ int Diff::count() const
 
 Patch Diff::patch(int index) const
 {
+  QMutexLocker locker(&d->lock);
   git_patch *patch = nullptr;
   git_patch_from_diff(&patch, d->diff, d->map.at(index));
   return Patch(patch);
 }
 
-QString Diff::name(int index) const
+QString Diff::name(int index, File file) const
 {
-  return d->delta(index)->new_file.path;
+  const git_diff_delta *delta = d->delta(index);
+  return (file == NewFile) ? delta->new_file.path : delta->old_file.path;
 }
 
 bool Diff::isBinary(int index) const
 {
+  QMutexLocker locker(&d->lock);
   return d->delta(index)->flags & GIT_DIFF_FLAG_BINARY;
 }
 
@@ -109,6 +204,7 @@ git_delta_t Diff::status(int index) const
 
 Id Diff::id(int index, File file) const
 {
+  QMutexLocker locker(&d->lock);
   const git_diff_delta *delta = d->delta(index);
   return (file == NewFile) ? delta->new_file.id : delta->old_file.id;
 }
@@ -126,22 +222,38 @@ int Diff::indexOf(const QString &name) const
 
 void Diff::merge(const Diff &diff)
 {
+  QMutexLocker locker(&d->lock);
   git_diff_merge(d->diff, diff);
   d->resetMap();
 }
 
-void Diff::findSimilar(bool untracked)
+bool Diff::findSimilar(bool untracked, Callbacks *callbacks, int timeout)
 {
   git_diff_find_options opts = GIT_DIFF_FIND_OPTIONS_INIT;
   if (untracked)
     opts.flags = GIT_DIFF_FIND_FOR_UNTRACKED;
 
-  git_diff_find_similar(d->diff, &opts);
+  Similarity similarity(callbacks, timeout);
+  git_diff_similarity_metric metric = {
+    &Similarity::fileSignature,
+    &Similarity::bufferSignature,
+    &Similarity::freeSignature,
+    &Similarity::compare,
+    &similarity
+  };
+
+  if (callbacks || timeout >= 0)
+    opts.metric = &metric;
+
+  QMutexLocker locker(&d->lock);
+  int error = git_diff_find_similar(d->diff, &opts);
   d->resetMap();
+  return !error;
 }
 
 void Diff::sort(SortRole role, Qt::SortOrder order)
 {
+  QMutexLocker locker(&d->lock);
   bool ascending = (order == Qt::AscendingOrder);
   std::sort(d->map.begin(), d->map.end(),
   [this, role, ascending](int lhs, int rhs) {
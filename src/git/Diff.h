@@ -14,6 +14,7 @@
 #include "Index.h"
 #include "git2/diff.h"
 #include <QFlags>
+#include <QMutex>
 #include <QSharedPointer>
 
 namespace git {
@@ -62,7 +63,7 @@ public:
 
   int count() const;
   Patch patch(int index) const;
-  QString name(int index) const;
+  QString name(int index, File file = NewFile) const;
   bool isBinary(int index) const;
   git_delta_t status(int index) const;
   Id id(int index, File file) const;
@@ -72,8 +73,12 @@ public:
   // Merge the given diff into this diff.
   void merge(const Diff &diff);
 
-  // Detect renames, copies, etc. This is expensive.
-  void findSimilar(bool untracked = false);
+  // Detect renames, copies, etc. This is expensive. Return false if
+  // canceled by the callbacks or if the timeout (in ms) expired first.
+  bool findSimilar(
+    bool untracked = false,
+    Callbacks *callbacks = nullptr,
+    int timeout = -1);
 
   void sort(SortRole role, Qt::SortOrder order = Qt::AscendingOrder);
 
@@ -93,6 +98,10 @@ private:
     git_diff *diff;
     QList<int> map;
     Index index;
+
+    // Generating a patch writes the flags and ids of its delta.
+    // Patches may be generated on a worker while the diff is shown.
+    QMutex lock;
   };
 
   Diff(git_diff *diff);
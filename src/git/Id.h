@@ -43,6 +43,7 @@ private:
 
   friend class Index;
   friend class Repository;
+  friend class RevWalk;
 };
 
 uint qHash(const Id &key);
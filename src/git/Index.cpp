@@ -9,25 +9,206 @@
 
 #include "Index.h"
 #include "Commit.h"
+#include "Config.h"
+#include "Diff.h"
 #include "Reference.h"
 #include "Repository.h"
 #include "Signature.h"
 #include "Submodule.h"
 #include "Tree.h"
+#include "git2/blob.h"
 #include "git2/commit.h"
 #include "git2/ignore.h"
 #include "git2/refs.h"
 #include "git2/repository.h"
 #include "git2/status.h"
 #include "git2/tree.h"
+#include <QAtomicInt>
 #include <QDateTime>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QVector>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
 
 namespace git {
 
 namespace {
 
+// Hash files on multiple threads when staging at least this many.
+const int kParallelFiles = 256;
+
+// Report hashing progress at this interval.
+const int kProgressInterval = 100; // ms
+
+// Prompt for files larger than this and stage them in the background.
+const qint64 kLargeFileSize = 10000000; // 10MB
+
+// Stream large files in chunks of this size.
+const int kChunkSize = 1024 * 1024;
+
+#ifdef Q_OS_WIN
+// Convert 100 ns intervals since 1601 the way libgit2 does.
+void setTime(const FILETIME &ft, git_index_time &time)
+{
+  qint64 ticks = (qint64(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+  ticks -= Q_INT64_C(116444736000000000);
+  time.seconds = ticks / 10000000;
+  time.nanoseconds = (ticks % 10000000) * 100;
+}
+#endif
+
+// Fill the stat fields that the index compares.
+bool statFile(const QString &path, Index::HashedFile &file)
+{
+  git_index_entry &entry = file.entry;
+  memset(&entry, 0, sizeof(git_index_entry));
+
+#ifdef Q_OS_WIN
+  // Read the same attribute data that libgit2 uses for lstat.
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  QString native = QDir::toNativeSeparators(path);
+  if (!GetFileAttributesExW(reinterpret_cast<LPCWSTR>(native.utf16()),
+                            GetFileExInfoStandard, &data))
+    return false;
+
+  bool link = (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) &&
+              QFileInfo(path).isSymLink();
+  if (!link && (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+    return false;
+
+  setTime(data.ftCreationTime, entry.ctime);
+  setTime(data.ftLastWriteTime, entry.mtime);
+  file.size = (qint64(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+  entry.mode = link ? GIT_FILEMODE_LINK : GIT_FILEMODE_BLOB;
+#else
+  struct stat st;
+  if (lstat(QFile::encodeName(path), &st) || S_ISDIR(st.st_mode))
+    return false;
+
+#ifdef Q_OS_MAC
+  entry.ctime.seconds = st.st_ctimespec.tv_sec;
+  entry.ctime.nanoseconds = st.st_ctimespec.tv_nsec;
+  entry.mtime.seconds = st.st_mtimespec.tv_sec;
+  entry.mtime.nanoseconds = st.st_mtimespec.tv_nsec;
+#else
+  entry.ctime.seconds = st.st_ctim.tv_sec;
+  entry.ctime.nanoseconds = st.st_ctim.tv_nsec;
+  entry.mtime.seconds = st.st_mtim.tv_sec;
+  entry.mtime.nanoseconds = st.st_mtim.tv_nsec;
+#endif
+  entry.dev = st.st_dev;
+  entry.ino = st.st_ino;
+  entry.uid = st.st_uid;
+  entry.gid = st.st_gid;
+  file.size = st.st_size;
+
+  if (S_ISLNK(st.st_mode)) {
+    entry.mode = GIT_FILEMODE_LINK;
+  } else if (st.st_mode & S_IXUSR) {
+    entry.mode = GIT_FILEMODE_BLOB_EXECUTABLE;
+  } else {
+    entry.mode = GIT_FILEMODE_BLOB;
+  }
+#endif
+
+  entry.file_size = file.size;
+  return true;
+}
+
+// Get the cache entry for the stat data and id of the file.
+Index::WorkdirId cacheEntry(const Index::HashedFile &file)
+{
+  const git_index_entry &entry = file.entry;
+  Index::WorkdirId id;
+  id.size = file.size;
+  id.mtime = entry.mtime.seconds * Q_INT64_C(1000000000) +
+             entry.mtime.nanoseconds;
+  id.ctime = entry.ctime.seconds * Q_INT64_C(1000000000) +
+             entry.ctime.nanoseconds;
+  id.ino = entry.ino;
+  id.id = entry.id;
+  return id;
+}
+
+// Write blobs and stat files claimed from a shared list.
+class FileHasher : public QRunnable
+{
+public:
+  struct State
+  {
+    QAtomicInt next;
+    QAtomicInt done;
+    QAtomicInt canceled;
+  };
+
+  FileHasher(
+    git_repository *repo,
+    const QString &workdir,
+    QVector<Index::HashedFile> &files,
+    State &state)
+    : mRepo(repo), mWorkdir(workdir),
+      mFiles(files.data()), mCount(files.size()), mState(state)
+  {}
+
+  void run() override
+  {
+    int i;
+    while (!mState.canceled.loadAcquire() &&
+           (i = mState.next.fetchAndAddRelaxed(1)) < mCount) {
+      Index::HashedFile &file = mFiles[i];
+      QString path = mWorkdir + '/' + QString::fromUtf8(file.path);
+      if (!statFile(path, file)) {
+        file.error = -1;
+      } else {
+        file.error = git_blob_create_from_workdir(
+          &file.entry.id, mRepo, file.path);
+      }
+
+      mState.done.fetchAndAddRelaxed(1);
+    }
+  }
+
+private:
+  git_repository *mRepo;
+  QString mWorkdir;
+  Index::HashedFile *mFiles;
+  int mCount;
+  State &mState;
+};
+
+// Hash on a thread pool. Callbacks are only called on this thread.
+bool hashFiles(
+  git_repository *repo,
+  const QString &workdir,
+  QVector<Index::HashedFile> &files,
+  Index::Callbacks *callbacks)
+{
+  FileHasher::State state;
+  QThreadPool pool;
+  for (int i = 0; i < pool.maxThreadCount(); ++i)
+    pool.start(new FileHasher(repo, workdir, files, state));
+
+  while (!pool.waitForDone(kProgressInterval)) {
+    int done = state.done.loadAcquire();
+    if (callbacks && !callbacks->progress(QString(), done, files.size()))
+      state.canceled.storeRelease(1);
+  }
+
+  return !state.canceled.loadAcquire();
+}
+
 void countDirectoryEntries(const QString &file, int &count)
 {
   QDir dir(file);
@@ -46,6 +227,39 @@ void countDirectoryEntries(const QString &file, int &count)
   }
 }
 
+struct EntryState
+{
+  QByteArray path;
+  int stage;
+  git_oid id;
+  uint32_t mode;
+};
+
+// Entries are sorted by path and then stage.
+QVector<EntryState> entryStates(git_index *index)
+{
+  QVector<EntryState> entries;
+  int count = git_index_entrycount(index);
+  entries.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    const git_index_entry *entry = git_index_get_byindex(index, i);
+    EntryState state;
+    state.path = entry->path;
+    state.stage = git_index_entry_stage(entry);
+    git_oid_cpy(&state.id, &entry->id);
+    state.mode = entry->mode;
+    entries.append(state);
+  }
+
+  return entries;
+}
+
+int compare(const EntryState &lhs, const EntryState &rhs)
+{
+  int cmp = qstrcmp(lhs.path, rhs.path);
+  return cmp ? cmp : lhs.stage - rhs.stage;
+}
+
 } // anon. namespace
 
 Index::Data::Data(git_index *index)
@@ -151,12 +365,74 @@ Index::StagedState Index::isStaged(const QString &path) const
   return d->stagedCache.insert(path, PartiallyStaged).value();
 }
 
+void Index::cacheStagedStates(const Diff &staged, const Diff &unstaged) const
+{
+  QHash<QString,int> indexDeltas;
+  int stagedCount = staged.count();
+  for (int i = 0; i < stagedCount; ++i)
+    indexDeltas.insert(staged.name(i), i);
+
+  QSet<QString> unstagedPaths;
+  int unstagedCount = unstaged.count();
+  for (int i = 0; i < unstagedCount; ++i) {
+    QString path = unstaged.name(i);
+    unstagedPaths.insert(path);
+
+    int j = indexDeltas.value(path, -1);
+    switch (unstaged.status(i)) {
+      case GIT_DELTA_UNTRACKED:
+        d->stagedCache.insert(path, Unstaged);
+        continue;
+
+      case GIT_DELTA_CONFLICTED:
+        d->stagedCache.insert(path, Conflicted);
+        continue;
+
+      default:
+        break;
+    }
+
+    // Handle dirty submodules.
+    if (mode(path) == GIT_FILEMODE_COMMIT) {
+      Id head = (j >= 0) ? staged.id(j, Diff::OldFile) :
+                           unstaged.id(i, Diff::OldFile);
+      if (head == unstaged.id(i, Diff::NewFile)) {
+        d->stagedCache.insert(path, Disabled);
+        continue;
+      }
+    }
+
+    d->stagedCache.insert(path, (j >= 0) ? PartiallyStaged : Unstaged);
+  }
+
+  // The workdir matches the index.
+  for (int i = 0; i < stagedCount; ++i) {
+    QString path = staged.name(i);
+    if (!unstagedPaths.contains(path)) {
+      bool conflicted = (staged.status(i) == GIT_DELTA_CONFLICTED);
+      d->stagedCache.insert(path, conflicted ? Conflicted : Staged);
+    }
+  }
+}
+
 void Index::setStaged(const QStringList &files, bool staged, bool yieldFocus)
 {
   bool dirAdded = false;
   QStringList changedFiles;
   Repository repo(git_index_owner(d->index));
   RepositoryNotifier *notifier = repo.notifier();
+  emit notifier->indexAboutToBeChanged();
+
+  // Resolve the HEAD tree and submodules once for the whole batch.
+  QDir workdir = repo.workdir();
+  Tree tree = staged ? Tree() : headTree();
+
+  QSet<QString> submodules;
+  foreach (const Submodule &submodule, repo.submodules())
+    submodules.insert(submodule.path());
+
+  // Regular files are added together after the loop.
+  QStringList addedFiles;
   foreach (const QString &file, files) {
     QByteArray path = file.toUtf8();
 
@@ -165,15 +441,18 @@ void Index::setStaged(const QStringList &files, bool staged, bool yieldFocus)
     bool fileExists = false;
     uint32_t fileMode = GIT_FILEMODE_UNREADABLE;
     if (staged) {
-      fileExists = repo.workdir().exists(file);
+      fileExists = workdir.exists(file);
     } else {
-      // Lookup HEAD commit.
-      fileId = headId(file, &fileMode);
+      fileId = headId(tree, file, &fileMode);
       fileExists = !fileId.isNull();
     }
 
     // submodule
-    if (Submodule submodule = repo.lookupSubmodule(file)) {
+    Submodule submodule;
+    if (submodules.contains(file))
+      submodule = repo.lookupSubmodule(file);
+
+    if (submodule.isValid()) {
       if (staged) {
         if (git_submodule_add_to_index(submodule, false))
           continue;
@@ -221,41 +500,50 @@ void Index::setStaged(const QStringList &files, bool staged, bool yieldFocus)
     // regular file
     if (staged) {
       if (fileExists) {
-        QDir dir = repo.workdir();
-        QFileInfo info(dir.filePath(file));
+        QFileInfo info(workdir.filePath(file));
         if (!info.isSymLink() && info.isDir()) {
-          // FIXME: This is a workaround.
-          QString current = QDir::currentPath();
-          QDir::setCurrent(dir.path());
-
           int count = 0;
           bool allow = true;
-          countDirectoryEntries(file, count);
+          countDirectoryEntries(info.filePath(), count);
           emit notifier->directoryAboutToBeStaged(
             file, count, allow);
-          bool added = (allow && addDirectory(file));
+          if (!allow)
+            continue;
 
-          QDir::setCurrent(current);
+          // Let the app stage the directory in the background.
+          bool handled = false;
+          emit notifier->directoryStageRequested(*this, file, handled);
+          if (handled)
+            continue;
 
-          if (!added)
+          QVector<HashedFile> hashed;
+          hashDirectory(file, hashed);
+          if (addHashedFiles(hashed).isEmpty())
             continue;
 
           dirAdded = true;
 
         } else {
-          int size = QFileInfo(repo.workdir(), file).size();
+          qint64 size = info.size();
           bool allow = true;
-          if (size > 10000000) // 10MB
+          bool large = (size > kLargeFileSize);
+          if (large)
             emit notifier->largeFileAboutToBeStaged(
               file, size, allow);
 
           if (!allow)
             continue;
 
-          if (git_index_add_bypath(d->index, path)) {
-            emit notifier->indexStageError(file);
-            continue;
+          // Let the app stage large files in the background.
+          if (large) {
+            bool handled = false;
+            emit notifier->largeFileStageRequested(*this, file, handled);
+            if (handled)
+              continue;
           }
+
+          addedFiles.append(file);
+          continue;
         }
 
       } else {
@@ -292,6 +580,8 @@ void Index::setStaged(const QStringList &files, bool staged, bool yieldFocus)
     changedFiles.append(file);
   }
 
+  changedFiles.append(addFiles(addedFiles));
+
   if (!changedFiles.isEmpty()) {
     git_index_write(d->index);
     foreach (const QString &changedFile, changedFiles)
@@ -305,6 +595,9 @@ void Index::setStaged(const QStringList &files, bool staged, bool yieldFocus)
 
 void Index::add(const QString &path, const QByteArray &buffer)
 {
+  git::Repository repo(git_index_owner(d->index));
+  emit repo.notifier()->indexAboutToBeChanged();
+
   const git_index_entry *entry = this->entry(path);
   if (!entry) {
     git_index_add_bypath(d->index, path.toUtf8());
@@ -319,13 +612,52 @@ void Index::add(const QString &path, const QByteArray &buffer)
 
   git_index_write(d->index);
   d->stagedCache.remove(path);
-  git::Repository repo(git_index_owner(d->index));
   emit repo.notifier()->indexChanged({path});
 }
 
-void Index::read()
+bool Index::read(QStringList *paths)
 {
+  git_oid checksum;
+  git_oid_cpy(&checksum, git_index_checksum(d->index));
+
+  QVector<EntryState> previous;
+  if (paths)
+    previous = entryStates(d->index);
+
   git_index_read(d->index, false);
+  if (git_oid_equal(&checksum, git_index_checksum(d->index)))
+    return false;
+
+  if (!paths)
+    return true;
+
+  // Merge the sorted entry lists.
+  QSet<QByteArray> changed;
+  QVector<EntryState> current = entryStates(d->index);
+  int i = 0, j = 0;
+  while (i < previous.size() || j < current.size()) {
+    int cmp = (i == previous.size()) ? 1 :
+              (j == current.size()) ? -1 :
+              compare(previous.at(i), current.at(j));
+    if (cmp < 0) {
+      changed.insert(previous.at(i++).path);
+    } else if (cmp > 0) {
+      changed.insert(current.at(j++).path);
+    } else {
+      const EntryState &lhs = previous.at(i++);
+      const EntryState &rhs = current.at(j++);
+      if (lhs.mode != rhs.mode || !git_oid_equal(&lhs.id, &rhs.id))
+        changed.insert(lhs.path);
+    }
+  }
+
+  foreach (const QByteArray &path, changed) {
+    QString file = QString::fromUtf8(path);
+    d->stagedCache.remove(file);
+    paths->append(file);
+  }
+
+  return true;
 }
 
 Tree Index::writeTree() const
@@ -358,44 +690,257 @@ const git_index_entry *Index::entry(const QString &path, int stage) const
   return git_index_get_bypath(d->index, path.toUtf8(), stage);
 }
 
-bool Index::addDirectory(const QString &file) const
+bool Index::hashDirectory(
+  const QString &dir,
+  QVector<HashedFile> &files,
+  Callbacks *callbacks) const
 {
-  QDir dir(file);
+  // Don't register the repository off of the main thread.
   git_repository *repo = git_index_owner(d->index);
+  QDir workdir(QString::fromUtf8(git_repository_workdir(repo)));
+
+  // Untracked directories are named with a trailing slash.
+  QString root = dir;
+  if (root.endsWith('/'))
+    root.chop(1);
+
+  // Walk without recursion. Prune ignored directories.
+  QStringList dirs(root);
   auto filters = QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot;
-  foreach (const QString &entry, dir.entryList(filters)) {
-    QString file = dir.filePath(entry);
-    if (QFileInfo(file).isDir()) {
-      if (!addDirectory(file))
-        return false;
-      continue;
+  while (!dirs.isEmpty()) {
+    QString path = dirs.takeLast();
+    if (callbacks && !callbacks->progress(path, files.size(), 0))
+      return false;
+
+    QDir current(workdir.filePath(path));
+    foreach (const QFileInfo &info, current.entryInfoList(filters)) {
+      QString name = path + '/' + info.fileName();
+      bool isDir = (!info.isSymLink() && info.isDir());
+
+      int ignored = 0;
+      QByteArray key = (isDir ? name + '/' : name).toUtf8();
+      if (git_ignore_path_is_ignored(&ignored, repo, key) || ignored)
+        continue;
+
+      if (isDir) {
+        dirs.append(name);
+        continue;
+      }
+
+      HashedFile file;
+      file.path = name.toUtf8();
+      files.append(file);
     }
+  }
 
-    int ignored = 0;
-    QByteArray path = file.toUtf8();
-    if (git_ignore_path_is_ignored(&ignored, repo, path) || ignored)
-      continue;
+  return hashFiles(repo, workdir.path(), files, callbacks);
+}
 
-    if (git_index_add_bypath(d->index, path))
+void Index::addDirectory(const QString &dir, QVector<HashedFile> &files)
+{
+  Repository repo(git_index_owner(d->index));
+  emit repo.notifier()->indexAboutToBeChanged();
+
+  if (addHashedFiles(files).isEmpty())
+    return;
+
+  git_index_write(d->index);
+  d->stagedCache.remove(dir);
+
+  emit repo.notifier()->indexChanged({dir});
+  emit repo.notifier()->directoryStaged();
+}
+
+bool Index::hashFile(
+  const QString &path,
+  HashedFile &file,
+  Callbacks *callbacks) const
+{
+  // Don't register the repository off of the main thread.
+  git_repository *repo = git_index_owner(d->index);
+  QDir workdir(QString::fromUtf8(git_repository_workdir(repo)));
+
+  file.path = path.toUtf8();
+  QString fullPath = workdir.filePath(path);
+  if (!statFile(fullPath, file)) {
+    file.error = -1;
+    return true;
+  }
+
+  // Links are small.
+  if (file.entry.mode == GIT_FILEMODE_LINK) {
+    file.error = git_blob_create_from_workdir(
+      &file.entry.id, repo, file.path);
+    return true;
+  }
+
+  QFile in(fullPath);
+  if (!in.open(QFile::ReadOnly)) {
+    file.error = -1;
+    return true;
+  }
+
+  // Filters are applied to the streamed content.
+  git_writestream *stream = nullptr;
+  if ((file.error = git_blob_create_from_stream(&stream, repo, file.path)))
+    return true;
+
+  qint64 current = 0;
+  QByteArray buffer(kChunkSize, Qt::Uninitialized);
+  forever {
+    qint64 len = in.read(buffer.data(), kChunkSize);
+    if (len <= 0) {
+      if (len < 0)
+        file.error = -1;
+      break;
+    }
+
+    if ((file.error = stream->write(stream, buffer.constData(), len)))
+      break;
+
+    current += len;
+    int total = file.size / 1024;
+    if (callbacks && !callbacks->progress(path, current / 1024, total)) {
+      stream->free(stream);
       return false;
+    }
   }
 
+  if (file.error) {
+    stream->free(stream);
+    return true;
+  }
+
+  file.error = git_blob_create_from_stream_commit(&file.entry.id, stream);
   return true;
 }
 
-Id Index::headId(const QString &path, uint32_t *mode) const
+void Index::addFile(HashedFile &file)
+{
+  Repository repo(git_index_owner(d->index));
+  emit repo.notifier()->indexAboutToBeChanged();
+
+  QVector<HashedFile> files(1, file);
+  QStringList added = addHashedFiles(files);
+  if (added.isEmpty())
+    return;
+
+  git_index_write(d->index);
+  d->stagedCache.remove(added.first());
+
+  emit repo.notifier()->indexChanged(added);
+}
+
+QStringList Index::addFiles(const QStringList &files) const
+{
+  QStringList added;
+  Repository repo(git_index_owner(d->index));
+  RepositoryNotifier *notifier = repo.notifier();
+
+  // Let libgit2 stat and hash small batches.
+  if (files.size() < kParallelFiles) {
+    foreach (const QString &file, files) {
+      if (git_index_add_bypath(d->index, file.toUtf8())) {
+        emit notifier->indexStageError(file);
+        continue;
+      }
+
+      added.append(file);
+    }
+
+    return added;
+  }
+
+  // Hash and write blobs in parallel.
+  QVector<HashedFile> hashed(files.size());
+  for (int i = 0; i < files.size(); ++i)
+    hashed[i].path = files.at(i).toUtf8();
+
+  hashFiles(repo, repo.workdir().path(), hashed, nullptr);
+  return addHashedFiles(hashed);
+}
+
+QStringList Index::addHashedFiles(QVector<HashedFile> &hashed) const
+{
+  QStringList added;
+  Repository repo(git_index_owner(d->index));
+  RepositoryNotifier *notifier = repo.notifier();
+
+  // Insert in sorted order. Keep the mode if the filesystem can't be trusted.
+  std::sort(hashed.begin(), hashed.end(),
+  [](const HashedFile &lhs, const HashedFile &rhs) {
+    return lhs.path < rhs.path;
+  });
+
+  bool filemode = repo.config().value<bool>("core.filemode", true);
+  for (int i = 0; i < hashed.size(); ++i) {
+    HashedFile &file = hashed[i];
+    QString name = QString::fromUtf8(file.path);
+    if (file.error) {
+      emit notifier->indexStageError(name);
+      continue;
+    }
+
+    // Let libgit2 resolve conflicts.
+    if (entry(name, 1) || entry(name, 2) || entry(name, 3)) {
+      if (git_index_add_bypath(d->index, file.path)) {
+        emit notifier->indexStageError(name);
+        continue;
+      }
+
+      added.append(name);
+      continue;
+    }
+
+    file.entry.path = file.path;
+    // New entries aren't executable unless the mode is trusted.
+    if (!filemode && file.entry.mode != GIT_FILEMODE_LINK) {
+      const git_index_entry *entry = this->entry(name);
+      file.entry.mode = entry ? entry->mode : GIT_FILEMODE_BLOB;
+    }
+
+    if (git_index_add(d->index, &file.entry)) {
+      emit notifier->indexStageError(name);
+      continue;
+    }
+
+    // Don't hash the file again to check its staged state.
+    repo.d->workdirIdsLock.lock();
+    repo.d->workdirIds.insert(name, cacheEntry(file));
+    repo.d->workdirIdsLock.unlock();
+
+    added.append(name);
+  }
+
+  return added;
+}
+
+Tree Index::headTree() const
 {
   Repository repo(git_index_owner(d->index));
   Reference head = repo.head();
   if (!head.isValid())
-    return Id();
+    return Tree();
 
   Commit commit = head.target();
-  if (!head.isValid())
+  if (!commit.isValid())
+    return Tree();
+
+  return commit.tree();
+}
+
+Id Index::headId(const QString &path, uint32_t *mode) const
+{
+  return headId(headTree(), path, mode);
+}
+
+Id Index::headId(const Tree &tree, const QString &path, uint32_t *mode) const
+{
+  if (!tree.isValid())
     return Id();
 
   git_tree_entry *entry = nullptr;
-  if (git_tree_entry_bypath(&entry, commit.tree(), path.toUtf8()))
+  if (git_tree_entry_bypath(&entry, tree, path.toUtf8()))
     return Id();
 
   if (mode)
@@ -423,15 +968,9 @@ Id Index::indexId(const QString &path, uint32_t *mode) const
 Id Index::workdirId(const QString &path, uint32_t *mode) const
 {
   Repository repo(git_index_owner(d->index));
-
-  git_oid id;
-  if (int error = git_repository_hashfile(
-        &id, repo, path.toUtf8(), GIT_OBJECT_BLOB, nullptr))
-    return (error == GIT_EUSER) ? Id::invalidId() : Id();
-
+  QFileInfo info(repo.workdir().filePath(path));
   if (mode) {
     *mode = GIT_FILEMODE_BLOB;
-    QFileInfo info(repo.workdir().filePath(path));
 #ifndef Q_OS_WIN
     if (info.isExecutable())
       *mode = GIT_FILEMODE_BLOB_EXECUTABLE;
@@ -440,6 +979,30 @@ Id Index::workdirId(const QString &path, uint32_t *mode) const
       *mode = GIT_FILEMODE_LINK;
   }
 
+  // Reuse the id if the file doesn't appear to have changed.
+  HashedFile file;
+  bool stat = statFile(info.filePath(), file);
+  WorkdirId current = cacheEntry(file);
+  if (stat) {
+    QMutexLocker locker(&repo.d->workdirIdsLock);
+    auto it = repo.d->workdirIds.constFind(path);
+    if (it != repo.d->workdirIds.constEnd() &&
+        it->size == current.size && it->mtime == current.mtime &&
+        it->ctime == current.ctime && it->ino == current.ino)
+      return it->id;
+  }
+
+  git_oid id;
+  if (int error = git_repository_hashfile(
+        &id, repo, path.toUtf8(), GIT_OBJECT_BLOB, nullptr))
+    return (error == GIT_EUSER) ? Id::invalidId() : Id();
+
+  if (stat) {
+    current.id = id;
+    QMutexLocker locker(&repo.d->workdirIdsLock);
+    repo.d->workdirIds.insert(path, current);
+  }
+
   return id;
 }
 
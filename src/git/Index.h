@@ -12,12 +12,15 @@
 
 #include "Id.h"
 #include "git2/index.h"
+#include <QHash>
 #include <QMap>
 #include <QSet>
 #include <QSharedPointer>
+#include <QVector>
 
 namespace git {
 
+class Diff;
 class Tree;
 
 class Index
@@ -43,6 +46,37 @@ public:
     }
   };
 
+  // A workdir file whose blob is already written.
+  struct HashedFile
+  {
+    QByteArray path;
+    git_index_entry entry;
+    qint64 size = 0;
+    int error = 0;
+  };
+
+  // The id of a workdir file is reused until its stat data changes.
+  // Times are in nanoseconds. The cache is kept per repository.
+  struct WorkdirId
+  {
+    qint64 size;
+    qint64 mtime;
+    qint64 ctime;
+    quint64 ino;
+    Id id;
+  };
+
+  class Callbacks
+  {
+  public:
+    // The total is zero until the walk is finished. Single
+    // files report the number of KiB hashed instead of files.
+    virtual bool progress(const QString &path, int current, int total)
+    {
+      return true;
+    }
+  };
+
   Index();
 
   bool isValid() const { return !d.isNull(); }
@@ -54,11 +88,35 @@ public:
 
   bool isTracked(const QString &path) const;
   StagedState isStaged(const QString &path) const;
+
+  // Derive the staged state of every path in the HEAD-to-index and
+  // index-to-workdir diffs at once. Other paths are computed on demand.
+  void cacheStagedStates(const Diff &staged, const Diff &unstaged) const;
   void setStaged(const QStringList &paths, bool staged, bool yieldFocus = true);
 
   void add(const QString &path, const QByteArray &buffer);
 
-  void read();
+  // Stage an untracked directory in two steps. Walk and hash on any
+  // thread, skipping ignored paths. Return false if canceled. Then add
+  // the hashed files and signal the change on the main thread.
+  bool hashDirectory(
+    const QString &dir,
+    QVector<HashedFile> &files,
+    Callbacks *callbacks = nullptr) const;
+  void addDirectory(const QString &dir, QVector<HashedFile> &files);
+
+  // Stage a large file in two steps. Stream it into the object
+  // database on any thread. Return false if canceled. Then add
+  // the hashed file and signal the change on the main thread.
+  bool hashFile(
+    const QString &path,
+    HashedFile &file,
+    Callbacks *callbacks = nullptr) const;
+  void addFile(HashedFile &file);
+
+  // Reload from disk. Return true if the index was rewritten.
+  // Optionally collect the paths whose entries changed.
+  bool read(QStringList *paths = nullptr);
   Tree writeTree() const;
 
   bool hasConflicts() const;
@@ -81,15 +139,21 @@ private:
 
   const git_index_entry *entry(const QString &path, int stage = 0) const;
 
-  bool addDirectory(const QString &path) const;
+  // Stage regular files. Large batches are hashed in parallel
+  // and inserted in sorted order. Return the files that were added.
+  QStringList addFiles(const QStringList &files) const;
+  QStringList addHashedFiles(QVector<HashedFile> &files) const;
 
+  Tree headTree() const;
   Id headId(const QString &path, uint32_t *mode = nullptr) const;
+  Id headId(const Tree &tree, const QString &path, uint32_t *mode) const;
   Id indexId(const QString &path, uint32_t *mode = nullptr) const;
   Id workdirId(const QString &path, uint32_t *mode = nullptr) const;
 
   QSharedPointer<Data> d;
 
   friend class Repository;
+  friend class StatusCache;
   friend class Tree;
 };
 
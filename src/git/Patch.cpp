@@ -12,7 +12,9 @@
 #include "Id.h"
 #include "Repository.h"
 #include "git2/filter.h"
+#include "git2/repository.h"
 #include <QDataStream>
+#include <QDir>
 #include <QFile>
 #include <QMap>
 
@@ -56,12 +58,13 @@ Patch::Patch(git_patch *patch)
   if (!isValid() || !isConflicted())
     return;
 
-  // Read conflict hunks.
-  Repository repo(git_patch_owner(patch));
-  if (!repo.isValid())
+  // Read conflict hunks. Patches may be generated on worker
+  // threads, so don't look up the repository wrapper here.
+  const char *workdir = git_repository_workdir(git_patch_owner(patch));
+  if (!workdir)
     return;
 
-  QFile file(repo.workdir().filePath(name(Diff::OldFile)));
+  QFile file(QDir(workdir).filePath(name(Diff::OldFile)));
   if (!file.open(QFile::ReadOnly))
     return;
 
@@ -504,6 +504,9 @@ void Remote::setName(const QString &name)
   if (git_remote_rename(&problems, repo, current, name.toUtf8()))
     return;
 
+  // Remote-tracking refs were renamed too.
+  Repository(repo).invalidateRefCache();
+
   // FIXME: Report problems?
   git_strarray_free(&problems);
 }
@@ -43,15 +43,22 @@
 #include "git2/stash.h"
 #include "git2/tag.h"
 #include "git2/sys/repository.h"
+#include <QDataStream>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QMap>
+#include <QMutexLocker>
 #include <QProcess>
+#include <QRunnable>
 #include <QSaveFile>
 #include <QStandardPaths>
 #include <QTextCodec>
+#include <QThread>
+#include <QThreadPool>
 #include <QVector>
+#include <algorithm>
+#include <cstring>
 
 #ifdef Q_OS_UNIX
 #include <pwd.h>
@@ -65,6 +72,68 @@ namespace {
 const QString kConfigDir = "gitahead";
 const QString kConfigFile = "config";
 const QString kStarFile = "starred";
+const QString kBloomFile = "bloom";
+
+const quint32 kBloomVersion = 1;
+const int kBloomWriteThreshold = 1024;
+
+// Split workdir diffs of indexes with at least this many entries.
+const int kParallelEntries = 4096;
+
+// Limit the diff to exact paths. The storage has to outlive the diff.
+void setPathspec(
+  git_diff_options &opts,
+  const QStringList &paths,
+  QVector<char *> &rawPaths,
+  QVector<QByteArray> &storage)
+{
+  if (paths.isEmpty())
+    return;
+
+  opts.flags |= GIT_DIFF_DISABLE_PATHSPEC_MATCH;
+  foreach (const QString &path, paths)
+    storage.append(path.toUtf8());
+  for (int i = 0; i < storage.size(); ++i)
+    rawPaths.append(storage[i].data());
+
+  opts.pathspec.count = rawPaths.size();
+  opts.pathspec.strings = rawPaths.data();
+}
+
+// Diff a subset of top-level entries on a pool thread.
+class DiffPartition : public QRunnable
+{
+public:
+  DiffPartition(
+    git_repository *repo,
+    git_index *index,
+    const git_diff_options &opts,
+    const QStringList &paths)
+    : mRepo(repo), mIndex(index), mOpts(opts), mPaths(paths)
+  {
+    setAutoDelete(false);
+  }
+
+  git_diff *diff() const { return mDiff; }
+  int error() const { return mError; }
+
+  void run() override
+  {
+    QVector<char *> rawPaths;
+    QVector<QByteArray> storage;
+    setPathspec(mOpts, mPaths, rawPaths, storage);
+    mError = git_diff_index_to_workdir(&mDiff, mRepo, mIndex, &mOpts);
+  }
+
+private:
+  git_repository *mRepo;
+  git_index *mIndex;
+  git_diff_options mOpts;
+  QStringList mPaths;
+
+  git_diff *mDiff = nullptr;
+  int mError = 0;
+};
 
 int blame_progress(const git_oid *suspect, void *payload)
 {
@@ -115,6 +184,26 @@ int insert_stash_id(
   return 0;
 }
 
+// Count the commits that aren't reachable from the hidden commit.
+int countSince(git_repository *repo, const git_oid *id, const git_oid *hide)
+{
+  git_revwalk *walk = nullptr;
+  if (git_revwalk_new(&walk, repo))
+    return -1;
+
+  int count = 0;
+  git_oid next;
+  if (!git_revwalk_push(walk, id) && !git_revwalk_hide(walk, hide)) {
+    while (!git_revwalk_next(&next, walk))
+      ++count;
+  } else {
+    count = -1;
+  }
+
+  git_revwalk_free(walk);
+  return count;
+}
+
 } // anon. namespace
 
 QMap<git_repository *,QWeakPointer<Repository::Data>> Repository::registry;
@@ -122,6 +211,74 @@ QMap<git_repository *,QWeakPointer<Repository::Data>> Repository::registry;
 Repository::Data::Data(git_repository *repo)
   : repo(repo), notifier(new RepositoryNotifier)
 {
+  // Keep the ref snapshot current.
+  QObject::connect(notifier, &RepositoryNotifier::referenceAdded,
+  [this](const Reference &ref) {
+    QMutexLocker locker(&refsLock);
+    if (refsCached && ref.isValid())
+      updateRef(ref.qualifiedName());
+  });
+
+  QObject::connect(notifier, &RepositoryNotifier::referenceUpdated,
+  [this](const Reference &ref) {
+    QMutexLocker locker(&refsLock);
+    if (!ref.isValid()) {
+      refsCached = false;
+    } else if (refsCached) {
+      updateRef(ref.qualifiedName());
+    }
+  });
+
+  QObject::connect(notifier, &RepositoryNotifier::referenceAboutToBeRemoved,
+  [this](const Reference &ref) {
+    QMutexLocker locker(&refsLock);
+    refsAboutToBeRemoved.append(ref.qualifiedName());
+  });
+
+  QObject::connect(notifier, &RepositoryNotifier::referenceRemoved, [this] {
+    // Removal may have failed. Look up the names again.
+    QMutexLocker locker(&refsLock);
+    if (refsCached) {
+      foreach (const QString &name, refsAboutToBeRemoved)
+        updateRef(name);
+    }
+
+    refsAboutToBeRemoved.clear();
+  });
+
+  // External ref changes are reported as updates. A
+  // full rescan means that anything may have changed.
+  QObject::connect(notifier, &RepositoryNotifier::workdirChanged,
+  [this](const QStringList &paths) {
+    if (!paths.isEmpty())
+      return;
+
+    QMutexLocker locker(&refsLock);
+    refsCached = false;
+  });
+
+  // Invalidate the describe index when tags change.
+  auto invalidate = [this] {
+    QMutexLocker locker(&descriptionsLock);
+    descriptionTags.clear();
+    descriptions.clear();
+    descriptionsCached = false;
+  };
+
+  auto invalidateTag = [invalidate](const Reference &ref) {
+    if (!ref.isValid() || ref.isTag())
+      invalidate();
+  };
+
+  QObject::connect(notifier, &RepositoryNotifier::referenceAdded, invalidateTag);
+  QObject::connect(notifier, &RepositoryNotifier::referenceUpdated, invalidateTag);
+  QObject::connect(notifier, &RepositoryNotifier::referenceRemoved, invalidate);
+  QObject::connect(notifier, &RepositoryNotifier::workdirChanged,
+  [invalidate](const QStringList &paths) {
+    if (paths.isEmpty())
+      invalidate();
+  });
+
   // Load starred commits.
   QDir dir(git_repository_path(repo));
   QFile file(appDir(dir).filePath(kStarFile));
@@ -138,10 +295,93 @@ Repository::Data::Data(git_repository *repo)
 
 Repository::Data::~Data()
 {
+  writeBloomFilters();
+
   delete notifier;
   git_repository_free(repo);
 }
 
+void Repository::Data::loadBloomFilters()
+{
+  bloomFiltersLoaded = true;
+
+  QDir dir(git_repository_path(repo));
+  QFile file(appDir(dir).filePath(kBloomFile));
+  if (!file.open(QIODevice::ReadOnly))
+    return;
+
+  QDataStream in(&file);
+  quint32 version = 0;
+  in >> version;
+  if (version != kBloomVersion) {
+    file.remove();
+    return;
+  }
+
+  while (!in.atEnd()) {
+    QByteArray id, data;
+    in >> id >> data;
+    if (in.status() != QDataStream::Ok || id.size() != GIT_OID_RAWSZ)
+      break;
+
+    bloomFilters.insert(id, data);
+  }
+}
+
+void Repository::Data::writeBloomFilters()
+{
+  if (bloomFiltersPending.isEmpty())
+    return;
+
+  // Append new records.
+  QDir dir(git_repository_path(repo));
+  QFile file(appDir(dir).filePath(kBloomFile));
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+    return;
+
+  QDataStream out(&file);
+  if (!file.size())
+    out << kBloomVersion;
+
+  foreach (const Id &id, bloomFiltersPending)
+    out << id.toByteArray() << bloomFilters.value(id).data();
+
+  bloomFiltersPending.clear();
+}
+
+void Repository::Data::updateRef(const QString &name)
+{
+  removeRef(name);
+
+  // HEAD isn't part of the snapshot.
+  if (!name.startsWith("refs/"))
+    return;
+
+  git_reference *ref = nullptr;
+  if (git_reference_lookup(&ref, repo, name.toUtf8()))
+    return;
+
+  Id id;
+  git_object *obj = nullptr;
+  if (!git_reference_peel(&obj, ref, GIT_OBJECT_COMMIT)) {
+    id = git_object_id(obj);
+    refNames.insert(id, name);
+  }
+
+  git_object_free(obj);
+
+  refs.insert(name, Reference(ref));
+  refTargets.insert(name, id);
+}
+
+void Repository::Data::removeRef(const QString &name)
+{
+  if (!refs.remove(name))
+    return;
+
+  refNames.remove(refTargets.take(name), name);
+}
+
 void Repository::unregisterRepository(Data *data)
 {
   registry.remove(data->repo);
@@ -280,7 +520,8 @@ void Repository::setIndex(const Index &index)
 
 Diff Repository::status(
   const Index &index,
-  Diff::Callbacks *callbacks) const
+  Diff::Callbacks *callbacks,
+  const QStringList &paths) const
 {
   Tree tree;
   if (Reference ref = head()) {
@@ -288,13 +529,16 @@ Diff Repository::status(
       tree = commit.tree();
   }
 
-  Diff diff = diffTreeToIndex(tree, index);
-  Diff workdir = diffIndexToWorkdir(index, callbacks);
+  Diff diff = diffTreeToIndex(tree, index, paths);
+  Diff workdir = diffIndexToWorkdir(index, callbacks, paths);
   if (!diff.isValid() || !workdir.isValid())
     return Diff();
 
+  // Derive staged state from both sides before they're merged.
+  if (index.isValid())
+    index.cacheStagedStates(diff, workdir);
+
   diff.merge(workdir);
-  diff.findSimilar(true);
   diff.setIndex(index);
 
   return diff.count() ? diff : Diff();
@@ -302,13 +546,18 @@ Diff Repository::status(
 
 Diff Repository::diffTreeToIndex(
   const Tree &tree,
-  const Index &index) const
+  const Index &index,
+  const QStringList &paths) const
 {
   git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
   opts.flags |= GIT_DIFF_INCLUDE_UNTRACKED;
   if (Settings::instance()->isWhitespaceIgnored())
     opts.flags |= GIT_DIFF_IGNORE_WHITESPACE;
 
+  QVector<char *> rawPaths;
+  QVector<QByteArray> storage;
+  setPathspec(opts, paths, rawPaths, storage);
+
   git_diff *diff = nullptr;
   git_diff_tree_to_index(&diff, d->repo, tree, index, &opts);
   return Diff(diff);
@@ -316,7 +565,9 @@ Diff Repository::diffTreeToIndex(
 
 Diff Repository::diffIndexToWorkdir(
   const Index &index,
-  Diff::Callbacks *callbacks) const
+  Diff::Callbacks *callbacks,
+  const QStringList &paths,
+  int threads) const
 {
   git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
   opts.flags |= (GIT_DIFF_INCLUDE_UNTRACKED | GIT_DIFF_DISABLE_MMAP);
@@ -328,11 +579,129 @@ Diff Repository::diffIndexToWorkdir(
     opts.payload = callbacks;
   }
 
+  if (index.isValid() && paths.isEmpty() && threads != 1) {
+    if (threads <= 0) {
+      bool large = (git_index_entrycount(index) >= kParallelEntries);
+      threads = large ? QThread::idealThreadCount() : 1;
+    }
+
+    if (threads > 1) {
+      QList<QStringList> partitions = partition(index, threads);
+      if (partitions.size() > 1)
+        return diffIndexToWorkdir(index, opts, partitions);
+    }
+  }
+
+  QVector<char *> rawPaths;
+  QVector<QByteArray> storage;
+  setPathspec(opts, paths, rawPaths, storage);
+
   git_diff *diff = nullptr;
   git_diff_index_to_workdir(&diff, d->repo, index, &opts);
   return Diff(diff);
 }
 
+Diff Repository::diffIndexToWorkdir(
+  const Index &index,
+  const git_diff_options &opts,
+  const QList<QStringList> &partitions) const
+{
+  // The repository and index are only read. Index
+  // iterators take their own snapshot of the entries.
+  QThreadPool pool;
+  pool.setMaxThreadCount(partitions.size());
+
+  QList<DiffPartition *> parts;
+  foreach (const QStringList &paths, partitions) {
+    DiffPartition *part = new DiffPartition(d->repo, index, opts, paths);
+    parts.append(part);
+    pool.start(part);
+  }
+
+  pool.waitForDone();
+
+  // Merge into the first part. Deltas stay sorted.
+  bool failed = false;
+  git_diff *diff = nullptr;
+  foreach (DiffPartition *part, parts) {
+    if (part->error() || !part->diff()) {
+      failed = true;
+    } else if (!diff) {
+      diff = part->diff();
+    } else {
+      if (git_diff_merge(diff, part->diff()))
+        failed = true;
+      git_diff_free(part->diff());
+    }
+  }
+
+  qDeleteAll(parts);
+
+  // Canceled or failed.
+  if (failed) {
+    git_diff_free(diff);
+    return Diff();
+  }
+
+  return Diff(diff);
+}
+
+QList<QStringList> Repository::partition(const Index &index, int count) const
+{
+  // Weigh top-level entries by their number of index entries.
+  // Entries with a common top-level name are adjacent.
+  QHash<QString,int> weights;
+  QByteArray name;
+  int weight = 0;
+  int entries = git_index_entrycount(index);
+  for (int i = 0; i < entries; ++i) {
+    const char *path = git_index_get_byindex(index, i)->path;
+    const char *slash = strchr(path, '/');
+    int len = slash ? slash - path : strlen(path);
+    if (len == name.length() && !memcmp(path, name.constData(), len)) {
+      ++weight;
+      continue;
+    }
+
+    if (weight)
+      weights[QString::fromUtf8(name)] += weight;
+
+    name = QByteArray(path, len);
+    weight = 1;
+  }
+
+  if (weight)
+    weights[QString::fromUtf8(name)] += weight;
+
+  // Untracked top-level entries aren't in the index.
+  QDir::Filters filters =
+    QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot;
+  foreach (const QString &entry, workdir().entryList(filters)) {
+    if (entry != ".git" && !weights.contains(entry))
+      weights.insert(entry, 1);
+  }
+
+  // Assign the heaviest entries first to the lightest partition.
+  QList<QPair<int,QString>> sorted;
+  for (auto it = weights.constBegin(); it != weights.constEnd(); ++it)
+    sorted.append(qMakePair(it.value(), it.key()));
+  std::sort(sorted.begin(), sorted.end());
+
+  count = qMin(count, sorted.size());
+  QList<QStringList> partitions;
+  QVector<int> totals(count);
+  for (int i = 0; i < count; ++i)
+    partitions.append(QStringList());
+
+  for (int i = sorted.size() - 1; i >= 0; --i) {
+    int min = std::min_element(totals.begin(), totals.end()) - totals.begin();
+    totals[min] += sorted.at(i).first;
+    partitions[min].append(sorted.at(i).second);
+  }
+
+  return partitions;
+}
+
 Reference Repository::head() const
 {
   git_reference *ref = nullptr;
@@ -378,18 +747,9 @@ bool Repository::setHeadDetached(const Commit &commit)
 
 QList<Reference> Repository::refs() const
 {
-  git_reference_iterator *it = nullptr;
-  if (git_reference_iterator_new(&it, d->repo))
-    return QList<Reference>();
-
-  QList<Reference> refs;
-  git_reference *ref = nullptr;
-  while (!git_reference_next(&ref, it))
-    refs.append(Reference(ref));
-
-  git_reference_iterator_free(it);
-
-  return refs;
+  QMutexLocker locker(&d->refsLock);
+  ensureRefsCached();
+  return d->refs.values();
 }
 
 Reference Repository::lookupRef(const QString &name) const
@@ -402,6 +762,44 @@ Reference Repository::lookupRef(const QString &name) const
   return Reference(ref);
 }
 
+QList<Reference> Repository::lookupRefs(const Id &target) const
+{
+  QMutexLocker locker(&d->refsLock);
+  ensureRefsCached();
+
+  QStringList names = d->refNames.values(target);
+  std::sort(names.begin(), names.end());
+
+  QList<Reference> refs;
+  foreach (const QString &name, names)
+    refs.append(d->refs.value(name));
+
+  return refs;
+}
+
+QList<Id> Repository::refTargets(bool includeStash) const
+{
+  QMutexLocker locker(&d->refsLock);
+  ensureRefsCached();
+
+  QList<Id> ids;
+  foreach (const Id &id, d->refNames.uniqueKeys()) {
+    if (includeStash) {
+      ids.append(id);
+      continue;
+    }
+
+    foreach (const QString &name, d->refNames.values(id)) {
+      if (name != "refs/stash") {
+        ids.append(id);
+        break;
+      }
+    }
+  }
+
+  return ids;
+}
+
 QList<Branch> Repository::branches(git_branch_t flags) const
 {
   git_branch_iterator *it = nullptr;
@@ -528,10 +926,10 @@ RevWalk Repository::walker(int sort) const
   if (git_revwalk_new(&revwalk, d->repo))
     return RevWalk();
 
-  RevWalk walker(revwalk);
+  RevWalk walker(revwalk, *this);
   git_revwalk_sorting(revwalk, sort);
-  foreach (const Reference &ref, refs())
-    git_revwalk_push_ref(revwalk, ref.qualifiedName().toUtf8());
+  foreach (const Id &id, refTargets())
+    git_revwalk_push(revwalk, id);
 
   return walker;
 }
@@ -702,6 +1100,9 @@ void Repository::deleteRemote(const QString &name)
 
   git_remote_delete(d->repo, name.toUtf8());
 
+  // Remote-tracking refs were deleted too.
+  invalidateRefCache();
+
   // We have to notify even if removal failed and the remote still exists.
   // Clients can lookup the remote by name to see if it was really removed.
   emit d->notifier->remoteRemoved(name);
@@ -1137,6 +1538,232 @@ void Repository::ensureSubmodulesCached() const
   }
 }
 
+BloomFilter Repository::bloomFilter(const Id &commit) const
+{
+  QMutexLocker locker(&d->bloomFiltersLock);
+  if (!d->bloomFiltersLoaded)
+    d->loadBloomFilters();
+
+  return d->bloomFilters.value(commit);
+}
+
+void Repository::addBloomFilter(
+  const Id &commit,
+  const BloomFilter &filter) const
+{
+  QMutexLocker locker(&d->bloomFiltersLock);
+  if (!d->bloomFiltersLoaded)
+    d->loadBloomFilters();
+
+  if (d->bloomFilters.contains(commit))
+    return;
+
+  d->bloomFilters.insert(commit, filter);
+  d->bloomFiltersPending.append(commit);
+  if (d->bloomFiltersPending.size() >= kBloomWriteThreshold)
+    d->writeBloomFilters();
+}
+
+void Repository::ensureRefsCached() const
+{
+  if (d->refsCached)
+    return;
+
+  d->refsCached = true;
+  d->refs.clear();
+  d->refTargets.clear();
+  d->refNames.clear();
+
+  git_reference_iterator *it = nullptr;
+  if (git_reference_iterator_new(&it, d->repo))
+    return;
+
+  git_reference *ref = nullptr;
+  while (!git_reference_next(&ref, it)) {
+    QString name = git_reference_name(ref);
+
+    Id id;
+    git_object *obj = nullptr;
+    if (!git_reference_peel(&obj, ref, GIT_OBJECT_COMMIT)) {
+      id = git_object_id(obj);
+      d->refNames.insert(id, name);
+    }
+
+    git_object_free(obj);
+
+    d->refs.insert(name, Reference(ref));
+    d->refTargets.insert(name, id);
+  }
+
+  git_reference_iterator_free(it);
+}
+
+void Repository::invalidateRefCache()
+{
+  QMutexLocker locker(&d->refsLock);
+  d->refsCached = false;
+}
+
+Repository::Description Repository::describe(const Commit &commit) const
+{
+  QMutexLocker locker(&d->descriptionsLock);
+  ensureDescriptionsCached();
+
+  if (d->descriptionTags.isEmpty())
+    return Description();
+
+  // Commits that weren't reachable when the index was built are resolved
+  // by descending into their parents until an indexed commit is found.
+  QList<Commit> stack = {commit};
+  while (!stack.isEmpty()) {
+    Commit top = stack.last();
+    Id id = top.id();
+    if (d->descriptions.contains(id)) {
+      stack.removeLast();
+      continue;
+    }
+
+    auto it = d->descriptionTags.constFind(id);
+    if (it != d->descriptionTags.constEnd()) {
+      Description description;
+      description.tag = it.value();
+      description.target = id;
+      description.distance = 0;
+      d->descriptions.insert(id, description);
+      stack.removeLast();
+      continue;
+    }
+
+    QList<Commit> parents = top.parents();
+    QList<Commit> missing;
+    foreach (const Commit &parent, parents) {
+      if (!d->descriptions.contains(parent.id()))
+        missing.append(parent);
+    }
+
+    if (!missing.isEmpty()) {
+      stack.append(missing);
+      continue;
+    }
+
+    Description description;
+    foreach (const Commit &parent, parents) {
+      const Description &candidate = d->descriptions[parent.id()];
+      if (candidate.distance >= 0 &&
+          (description.distance < 0 ||
+           candidate.distance + 1 < description.distance)) {
+        description.tag = candidate.tag;
+        description.target = candidate.target;
+        description.distance = candidate.distance + 1;
+      }
+    }
+
+    d->descriptions.insert(id, description);
+    stack.removeLast();
+  }
+
+  Description description = d->descriptions.value(commit.id());
+  if (!description.distance)
+    description.count = 0;
+  if (description.distance <= 0 || description.count >= 0)
+    return description;
+
+  // Count without holding the lock and remember the result.
+  locker.unlock();
+  Id id = commit.id();
+  description.count = countSince(d->repo, id, description.target);
+  if (description.count < 0)
+    description.count = description.distance;
+
+  locker.relock();
+  auto it = d->descriptions.find(id);
+  if (it != d->descriptions.end() && it->target == description.target)
+    it->count = description.count;
+
+  return description;
+}
+
+void Repository::ensureDescriptionsCached() const
+{
+  if (d->descriptionsCached)
+    return;
+
+  d->descriptionsCached = true;
+
+  git_revwalk *walk = nullptr;
+  if (git_revwalk_new(&walk, d->repo))
+    return;
+
+  // Collect tag targets and push every reference.
+  git_reference_iterator *it = nullptr;
+  if (git_reference_iterator_new(&it, d->repo)) {
+    git_revwalk_free(walk);
+    return;
+  }
+
+  git_reference *ref = nullptr;
+  while (!git_reference_next(&ref, it)) {
+    git_object *obj = nullptr;
+    if (!git_reference_peel(&obj, ref, GIT_OBJECT_COMMIT)) {
+      const git_oid *id = git_object_id(obj);
+      if (git_reference_is_tag(ref))
+        d->descriptionTags.insert(id, git_reference_shorthand(ref));
+      git_revwalk_push(walk, id);
+    }
+
+    git_object_free(obj);
+    git_reference_free(ref);
+  }
+
+  git_reference_iterator_free(it);
+
+  // Without tags there's nothing to describe.
+  if (d->descriptionTags.isEmpty()) {
+    git_revwalk_free(walk);
+    return;
+  }
+
+  git_revwalk_push_head(walk);
+
+  // Parents are visited before their children in reverse topological
+  // order, so each commit inherits the nearest tag of its parents.
+  git_revwalk_sorting(walk, GIT_SORT_TOPOLOGICAL | GIT_SORT_REVERSE);
+
+  git_oid id;
+  while (!git_revwalk_next(&id, walk)) {
+    Description description;
+    auto tag = d->descriptionTags.constFind(&id);
+    if (tag != d->descriptionTags.constEnd()) {
+      description.tag = tag.value();
+      description.target = &id;
+      description.distance = 0;
+      d->descriptions.insert(&id, description);
+      continue;
+    }
+
+    git_commit *commit = nullptr;
+    if (git_commit_lookup(&commit, d->repo, &id))
+      continue;
+
+    int count = git_commit_parentcount(commit);
+    for (int i = 0; i < count; ++i) {
+      auto parent = d->descriptions.constFind(git_commit_parent_id(commit, i));
+      if (parent != d->descriptions.constEnd() && parent->distance >= 0 &&
+          (description.distance < 0 ||
+           parent->distance + 1 < description.distance)) {
+        description.tag = parent->tag;
+        description.target = parent->target;
+        description.distance = parent->distance + 1;
+      }
+    }
+
+    git_commit_free(commit);
+    d->descriptions.insert(&id, description);
+  }
+
+  git_revwalk_free(walk);
+}
+
 QByteArray Repository::lfsExecute(
   const QStringList &args,
   const QByteArray &input) const
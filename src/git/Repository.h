@@ -13,6 +13,7 @@
 #include "AnnotatedCommit.h"
 #include "Blame.h"
 #include "Blob.h"
+#include "BloomFilter.h"
 #include "Commit.h"
 #include "Diff.h"
 #include "Index.h"
@@ -22,6 +23,8 @@
 #include "git2/types.h"
 #include <QCoreApplication>
 #include <QDir>
+#include <QHash>
+#include <QMutex>
 #include <QObject>
 #include <QSet>
 #include <QSharedPointer>
@@ -99,20 +102,34 @@ public:
   void setIndex(const Index &index);
 
   // status/diff
+  // Paths are exact files or directories. They limit the diff.
+  // Renames aren't detected in the status. Call findSimilar.
   Diff status(
     const Index &index,
-    Diff::Callbacks *callbacks) const;
+    Diff::Callbacks *callbacks,
+    const QStringList &paths = QStringList()) const;
   Diff diffTreeToIndex(
     const Tree &tree,
-    const Index &index = Index()) const;
+    const Index &index = Index(),
+    const QStringList &paths = QStringList()) const;
+  // Unlimited diffs of large indexes are split by top-level entry
+  // across threads. Pass one thread to diff on the calling thread.
   Diff diffIndexToWorkdir(
     const Index &index = Index(),
-    Diff::Callbacks *callbacks = nullptr) const;
+    Diff::Callbacks *callbacks = nullptr,
+    const QStringList &paths = QStringList(),
+    int threads = 0) const;
 
   // refs
   QList<Reference> refs() const;
   Reference lookupRef(const QString &name) const;
 
+  // Get refs that peel to the given commit.
+  QList<Reference> lookupRefs(const Id &target) const;
+
+  // Get the distinct commits that refs peel to.
+  QList<Id> refTargets(bool includeStash = true) const;
+
   Reference head() const;
   bool isHeadUnborn() const;
   bool isHeadDetached() const;
@@ -241,11 +258,30 @@ public:
   static void shutdown();
 
 private:
+  // The distance is the shortest parent path length to the tag. It picks
+  // the nearest tag. The count is the number of commits since the tag
+  // like git describe. It's counted once per commit when first needed.
+  struct Description
+  {
+    QString tag;
+    Id target;
+    int distance = -1;
+    int count = -1;
+  };
+
   struct Data
   {
     Data(git_repository *repo);
     ~Data();
 
+    // Update the ref snapshot. The caller must hold the refs lock.
+    void updateRef(const QString &name);
+    void removeRef(const QString &name);
+
+    // Load and append changed-path filters. The caller must hold the lock.
+    void loadBloomFilters();
+    void writeBloomFilters();
+
     git_repository *repo;
     RepositoryNotifier *notifier;
 
@@ -256,6 +292,32 @@ private:
     bool lfsLocksCached = false;
 
     QSet<Id> starredCommits;
+
+    // The ref snapshot is a sorted name table and a reverse map from
+    // peeled target to names. It's kept current by notifier signals.
+    QMutex refsLock;
+    QMap<QString,Reference> refs;
+    QHash<QString,Id> refTargets;
+    QMultiHash<Id,QString> refNames;
+    QStringList refsAboutToBeRemoved;
+    bool refsCached = false;
+
+    // The describe index maps each commit to its nearest tag. It's
+    // accessed from worker threads, so it's guarded by its own lock.
+    QMutex descriptionsLock;
+    QHash<Id,QString> descriptionTags;
+    QHash<Id,Description> descriptions;
+    bool descriptionsCached = false;
+
+    // Hashed workdir files outlive each index instance.
+    QMutex workdirIdsLock;
+    QHash<QString,Index::WorkdirId> workdirIds;
+
+    // Changed-path Bloom filters are persisted in the app dir.
+    QMutex bloomFiltersLock;
+    QHash<Id,BloomFilter> bloomFilters;
+    QList<Id> bloomFiltersPending;
+    bool bloomFiltersLoaded = false;
   };
 
   Repository(git_repository *repo);
@@ -263,6 +325,24 @@ private:
 
   void ensureSubmodulesCached() const;
 
+  // Diff each partition of top-level entries on its own thread.
+  Diff diffIndexToWorkdir(
+    const Index &index,
+    const git_diff_options &opts,
+    const QList<QStringList> &partitions) const;
+  QList<QStringList> partition(const Index &index, int count) const;
+
+  void ensureRefsCached() const;
+  void invalidateRefCache();
+
+  // Get and add changed-path filters for single parent commits.
+  BloomFilter bloomFilter(const Id &commit) const;
+  void addBloomFilter(const Id &commit, const BloomFilter &filter) const;
+
+  // Get the nearest tag, the distance and the count since the tag.
+  Description describe(const Commit &commit) const;
+  void ensureDescriptionsCached() const;
+
   QByteArray lfsExecute(
     const QStringList &args,
     const QByteArray &input = QByteArray()) const;
@@ -283,6 +363,7 @@ private:
   friend class Rebase;
   friend class Reference;
   friend class Remote;
+  friend class RevWalk;
   friend class Submodule;
   friend class TagRef;
 };
@@ -307,14 +388,29 @@ signals:
   void remoteRemoved(const QString &name);
 
   void stateChanged();
-  void workdirChanged();
+
+  // Paths are relative to the workdir. An empty
+  // list means that anything may have changed.
+  void workdirChanged(const QStringList &paths = QStringList());
 
   void directoryStaged();
   void directoryAboutToBeStaged(
     const QString &dir, int count, bool &allow);
+  // Set handled to stage the directory asynchronously into the index.
+  void directoryStageRequested(
+    const Index &index, const QString &dir, bool &handled);
   void largeFileAboutToBeStaged(
-    const QString &path, int size, bool &allow);
+    const QString &path, qint64 size, bool &allow);
+  // Set handled to stage the file asynchronously into the index.
+  void largeFileStageRequested(
+    const Index &index, const QString &path, bool &handled);
+  // Emitted before the app modifies the index. Stop reading it
+  // on other threads until the modification is finished.
+  void indexAboutToBeChanged();
   void indexChanged(const QStringList &paths, bool yieldFocus = true);
+
+  // The index was rewritten outside of the app.
+  void indexRewritten();
   void indexStageError(const QString &path);
 
   void lfsNotFound();
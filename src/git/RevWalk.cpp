@@ -8,9 +8,13 @@
 //
 
 #include "RevWalk.h"
+#include "BloomFilter.h"
 #include "Commit.h"
+#include "Id.h"
 #include "Reference.h"
+#include "Repository.h"
 #include "git2/commit.h"
+#include "git2/diff.h"
 #include "git2/pathspec.h"
 #include "git2/revwalk.h"
 #include <QRegularExpression>
@@ -29,8 +33,8 @@ int notify(const git_diff *, const git_diff_delta *, const char *, void *)
 
 RevWalk::RevWalk() {}
 
-RevWalk::RevWalk(git_revwalk *walker)
-  : d(walker, git_revwalk_free)
+RevWalk::RevWalk(git_revwalk *walker, const Repository &repo)
+  : d(walker, git_revwalk_free), mRepo(repo)
 {}
 
 bool RevWalk::hide(const Commit &commit)
@@ -44,6 +48,11 @@ bool RevWalk::hide(const Reference &ref)
   return commit.isValid() ? hide(commit) : false;
 }
 
+bool RevWalk::push(const Id &id)
+{
+  return !git_revwalk_push(d.data(), id);
+}
+
 bool RevWalk::push(const Commit &commit)
 {
   return !git_revwalk_push(d.data(), commit);
@@ -56,6 +65,13 @@ bool RevWalk::push(const Reference &ref)
 }
 
 Commit RevWalk::next(const QString &path) const
+{
+  return next(path, std::function<bool()>());
+}
+
+Commit RevWalk::next(
+  const QString &path,
+  const std::function<bool()> &interrupt) const
 {
   git_diff_options diffopts = GIT_DIFF_OPTIONS_INIT;
   diffopts.notify_cb = notify;
@@ -63,17 +79,35 @@ Commit RevWalk::next(const QString &path) const
   // Convert pathspec to UTF-8.
   QByteArray buffer = path.toUtf8();
   char *data = buffer.data();
+  bool glob = false;
   if (!path.isEmpty()) {
     diffopts.pathspec.count = 1;
     diffopts.pathspec.strings = &data;
-    if (!path.contains(QRegularExpression("[*?]")))
+    glob = path.contains(QRegularExpression("[*?]"));
+    if (!glob)
       diffopts.flags |= GIT_DIFF_DISABLE_PATHSPEC_MATCH;
   }
 
+  // Changed-path filters only apply to literal paths.
+  QByteArray key = buffer;
+  while (key.endsWith('/'))
+    key.chop(1);
+
+  git_repository *repo = git_revwalk_repository(d.data());
+  bool filtered = (!path.isEmpty() && !glob && !key.isEmpty());
+
   git_oid id;
-  while (!git_revwalk_next(&id, d.data())) {
+  while ((!interrupt || !interrupt()) && !git_revwalk_next(&id, d.data())) {
+    // Reject commits without loading them if the filter rules them out.
+    BloomFilter bloom;
+    if (filtered) {
+      bloom = mRepo.bloomFilter(&id);
+      if (bloom.isValid() && !bloom.contains(key))
+        continue;
+    }
+
     git_commit *commit = nullptr;
-    git_commit_lookup(&commit, git_revwalk_repository(d.data()), &id);
+    git_commit_lookup(&commit, repo, &id);
     Q_ASSERT(commit);
 
     if (path.isEmpty())
@@ -109,16 +143,44 @@ Commit RevWalk::next(const QString &path) const
         git_commit_tree(&a, parent);
         git_commit_tree(&b, commit);
 
-        git_diff *diff;
-        git_repository *repo = git_commit_owner(commit);
-        bool filter = !git_diff_tree_to_tree(&diff, repo, a, b, &diffopts);
+        bool match = false;
+        if (filtered && !bloom.isValid() && mBuildFilters) {
+          // Diff all paths once to build the filter for next time.
+          git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+          git_diff *diff = nullptr;
+          if (!git_diff_tree_to_tree(&diff, repo, a, b, &opts)) {
+            QList<QByteArray> paths;
+            size_t count = git_diff_num_deltas(diff);
+            for (size_t i = 0; i < count; ++i) {
+              const git_diff_delta *delta = git_diff_get_delta(diff, i);
+              paths.append(delta->old_file.path);
+              if (strcmp(delta->old_file.path, delta->new_file.path))
+                paths.append(delta->new_file.path);
+            }
+
+            // Match the path or any file under it.
+            foreach (const QByteArray &changed, paths) {
+              if (changed == key ||
+                  (changed.startsWith(key) && changed.at(key.length()) == '/'))
+                match = true;
+            }
+
+            mRepo.addBloomFilter(&id, BloomFilter::create(paths));
+          }
+
+          git_diff_free(diff);
+
+        } else {
+          git_diff *diff = nullptr;
+          match = git_diff_tree_to_tree(&diff, repo, a, b, &diffopts);
+          git_diff_free(diff);
+        }
 
-        git_diff_free(diff);
         git_tree_free(a);
         git_tree_free(b);
         git_commit_free(parent);
 
-        if (!filter)
+        if (match)
           return Commit(commit);
 
         break;
@@ -10,13 +10,16 @@
 #ifndef REVWALK_H
 #define REVWALK_H
 
+#include "Repository.h"
 #include <QSharedPointer>
+#include <functional>
 
 struct git_revwalk;
 
 namespace git {
 
 class Commit;
+class Id;
 class Reference;
 
 class RevWalk
@@ -29,17 +32,34 @@ public:
   bool hide(const Commit &commit);
   bool hide(const Reference &ref);
 
+  bool push(const Id &id);
   bool push(const Commit &commit);
   bool push(const Reference &ref);
 
+  // Build missing changed-path filters while walking with a literal path.
+  // This diffs all paths of each commit, so enable it only on workers.
+  void setBuildFilters(bool build) { mBuildFilters = build; }
+
   // Return the next commit that matches the given pathspec.
   Commit next(const QString &pathspec = QString()) const;
 
+  // Return the next matching commit or an invalid commit as soon as
+  // interrupt returns true. It's checked before each walk step so
+  // that the walk can continue later without skipping commits.
+  Commit next(
+    const QString &pathspec,
+    const std::function<bool()> &interrupt) const;
+
 protected:
-  RevWalk(git_revwalk *walker);
+  RevWalk(git_revwalk *walker, const Repository &repo);
 
   QSharedPointer<git_revwalk> d;
 
+  // The repository is captured on the thread that creates the walker
+  // so that walking on a worker doesn't look up the repository.
+  Repository mRepo;
+  bool mBuildFilters = false;
+
   friend class Commit;
   friend class Reference;
   friend class Repository;
@@ -0,0 +1,206 @@
+//
+//          Copyright (c) 2016, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#include "StatusCache.h"
+#include "Commit.h"
+#include "Diff.h"
+#include "Index.h"
+#include "Reference.h"
+#include "Tree.h"
+#include "git2/index.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+
+namespace git {
+
+namespace {
+
+const QString kStatusFile = "status";
+const quint32 kStatusVersion = 1;
+
+const QDir::Filters kFilters =
+  (QDir::AllEntries |
+   QDir::Hidden |
+   QDir::System |
+   QDir::NoDotAndDotDot);
+
+const QDir::Filters kDirFilters =
+  (QDir::Dirs |
+   QDir::Hidden |
+   QDir::NoDotAndDotDot);
+
+qint64 modified(const QFileInfo &info)
+{
+  return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+QByteArray headTree(const Repository &repo)
+{
+  if (Reference ref = repo.head()) {
+    if (Commit commit = ref.target())
+      return Object(commit.tree()).id().toByteArray();
+  }
+
+  return QByteArray();
+}
+
+QByteArray checksum(const Index &index)
+{
+  return Id(git_index_checksum(index)).toByteArray();
+}
+
+// Changes to ignore rules can change the status of any untracked file.
+qint64 excludes(const Repository &repo)
+{
+  return modified(QFileInfo(repo.dir().filePath("info/exclude")));
+}
+
+} // anon. namespace
+
+StatusCache::StatusCache(const Repository &repo)
+  : mRepo(repo)
+{}
+
+void StatusCache::record()
+{
+  mDirs.clear();
+  record(mRepo.workdir(), QString());
+}
+
+void StatusCache::save(const Index &index, const Diff &status)
+{
+  QSet<QString> dirty;
+  int count = status.isValid() ? status.count() : 0;
+  for (int i = 0; i < count; ++i) {
+    dirty.insert(status.name(i));
+    dirty.insert(status.name(i, Diff::OldFile));
+  }
+
+  QSaveFile file(mRepo.appDir().filePath(kStatusFile));
+  if (!file.open(QIODevice::WriteOnly))
+    return;
+
+  QDataStream out(&file);
+  out << kStatusVersion << headTree(mRepo) << checksum(index) <<
+    excludes(mRepo) << mDirs << dirty.toList();
+
+  file.commit();
+}
+
+bool StatusCache::changes(const Index &index, QStringList &paths) const
+{
+  QFile file(mRepo.appDir().filePath(kStatusFile));
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+
+  quint32 version = 0;
+  QByteArray tree, sum;
+  qint64 exclude = -1;
+  QHash<QString,qint64> dirs;
+  QStringList dirty;
+
+  QDataStream in(&file);
+  in >> version;
+  if (version != kStatusVersion)
+    return false;
+
+  in >> tree >> sum >> exclude >> dirs >> dirty;
+  if (in.status() != QDataStream::Ok)
+    return false;
+
+  // The index or HEAD changed. Staged changes are unknown.
+  if (tree != headTree(mRepo) || sum != checksum(index) ||
+      exclude != excludes(mRepo))
+    return false;
+
+  // Paths that were dirty may have become clean.
+  QSet<QString> result = dirty.toSet();
+
+  // Tracked files whose stat data differs from the index. Entries that
+  // are as new as the index file itself may be racily clean.
+  QDir workdir = mRepo.workdir();
+  qint64 indexTime = modified(QFileInfo(git_index_path(index)));
+  int count = git_index_entrycount(index);
+  for (int i = 0; i < count; ++i) {
+    const git_index_entry *entry = git_index_get_byindex(index, i);
+    QString path = QString::fromUtf8(entry->path);
+    QFileInfo info(workdir.filePath(path));
+
+    // Submodules and links can't be checked by stat data.
+    if (entry->mode == GIT_FILEMODE_COMMIT ||
+        entry->mode == GIT_FILEMODE_LINK || info.isSymLink()) {
+      result.insert(path);
+      continue;
+    }
+
+    bool mode = false;
+#ifndef Q_OS_WIN
+    bool executable = (entry->mode == GIT_FILEMODE_BLOB_EXECUTABLE);
+    mode = (info.isExecutable() != executable);
+#endif
+
+    qint64 time = qint64(entry->mtime.seconds) * 1000 +
+                  entry->mtime.nanoseconds / 1000000;
+    if (!info.exists() || modified(info) != time || time >= indexTime ||
+        quint32(info.size()) != entry->file_size || mode)
+      result.insert(path);
+  }
+
+  // Untracked entries can only appear in directories that changed.
+  for (auto it = dirs.constBegin(), end = dirs.constEnd(); it != end; ++it) {
+    QDir dir(workdir.filePath(it.key()));
+    if (modified(QFileInfo(dir.path())) == it.value())
+      continue;
+
+    foreach (const QString &name, dir.entryList(kFilters)) {
+      if (name == ".git")
+        continue;
+
+      QString path = it.key().isEmpty() ? name : it.key() + '/' + name;
+      if (dirs.contains(path) || git_index_get_bypath(index, path.toUtf8(), 0))
+        continue;
+
+      result.insert(path);
+    }
+  }
+
+  foreach (const QString &path, result) {
+    // Ignore rules may have changed.
+    if (path == ".gitignore" || path.endsWith("/.gitignore"))
+      return false;
+
+    paths.append(path);
+  }
+
+  return true;
+}
+
+void StatusCache::record(const QDir &dir, const QString &path)
+{
+  mDirs.insert(path, modified(QFileInfo(dir.path())));
+
+  foreach (const QString &name, dir.entryList(kDirFilters)) {
+    QString subdir = path.isEmpty() ? name : path + '/' + name;
+    QString fullPath = dir.filePath(name);
+    if (name == ".git" || QFileInfo(fullPath).isSymLink() ||
+        mRepo.isIgnored(fullPath))
+      continue;
+
+    // Submodules are checked through their index entry.
+    if (QFileInfo(QDir(fullPath).filePath(".git")).exists())
+      continue;
+
+    record(QDir(fullPath), subdir);
+  }
+}
+
+} // namespace git
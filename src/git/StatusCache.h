@@ -0,0 +1,49 @@
+//
+//          Copyright (c) 2016, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#ifndef STATUSCACHE_H
+#define STATUSCACHE_H
+
+#include "Repository.h"
+#include <QHash>
+#include <QStringList>
+
+namespace git {
+
+class Diff;
+class Index;
+
+// A snapshot of the last full status persisted in the app dir. It keeps
+// directory modification times (like git's untracked cache) and the dirty
+// paths so that later checks can be limited to paths that may have changed.
+class StatusCache
+{
+public:
+  StatusCache(const Repository &repo);
+
+  // Record directory modification times. Call before computing the status.
+  void record();
+
+  // Write the recorded directories with the status result.
+  void save(const Index &index, const Diff &status);
+
+  // Find the paths that may have changed since the snapshot. Return false
+  // if the snapshot is missing or stale and a full status is needed.
+  bool changes(const Index &index, QStringList &paths) const;
+
+private:
+  void record(const QDir &dir, const QString &path);
+
+  Repository mRepo;
+  QHash<QString,qint64> mDirs;
+};
+
+} // namespace git
+
+#endif
@@ -52,6 +52,12 @@ Object Tree::object(int index) const
   return Object(obj);
 }
 
+Id Tree::id(int index) const
+{
+  const git_tree_entry *entry = git_tree_entry_byindex(*this, index);
+  return entry ? Id(git_tree_entry_id(entry)) : Id();
+}
+
 Id Tree::id(const QString &path) const
 {
   git_tree_entry *entry = nullptr;
@@ -25,6 +25,8 @@ public:
   QString name(int index) const;
   Object object(int index) const;
 
+  // Get the id of an entry without loading the object.
+  Id id(int index) const;
   Id id(const QString &path) const;
 
 private:
@@ -76,6 +76,16 @@ public:
   void setFile(const QModelIndex &index, int width)
   {
     mIndex = index;
+
+    // History is filled in asynchronously.
+    const QAbstractItemModel *model = index.model();
+    if (model && model != mModel) {
+      disconnect(mConnection);
+      mModel = model;
+      mConnection = connect(model, &QAbstractItemModel::dataChanged,
+                            this, &PreviewWidget::updateHistory);
+    }
+
     if (!index.isValid() || index.model()->rowCount(index) > 0) {
       hide();
       return;
@@ -103,6 +113,25 @@ public:
 signals:
   void iconDoubleClicked(const QModelIndex &index);
 
+private slots:
+  void updateHistory(
+    const QModelIndex &topLeft,
+    const QModelIndex &bottomRight,
+    const QVector<int> &roles)
+  {
+    if (!isVisible() || !mIndex.isValid() ||
+        mIndex.parent() != topLeft.parent() ||
+        mIndex.row() < topLeft.row() || mIndex.row() > bottomRight.row())
+      return;
+
+    if (!roles.isEmpty() && !roles.contains(TreeModel::AddedRole) &&
+        !roles.contains(TreeModel::ModifiedRole))
+      return;
+
+    mAdded->setText(mIndex.data(TreeModel::AddedRole).toString());
+    mModified->setText(mIndex.data(TreeModel::ModifiedRole).toString());
+  }
+
 protected:
   void mouseDoubleClickEvent(QMouseEvent *event) override
   {
@@ -117,6 +146,9 @@ private:
   QLabel *mAdded;
   QLabel *mModified;
   QModelIndex mIndex;
+
+  const QAbstractItemModel *mModel = nullptr;
+  QMetaObject::Connection mConnection;
 };
 
 class ColumnViewDelegate : public QItemDelegate
@@ -9,6 +9,7 @@
 
 #include "CommitList.h"
 #include "Badge.h"
+#include "DiffCache.h"
 #include "Location.h"
 #include "MainWindow.h"
 #include "ProgressIndicator.h"
@@ -25,15 +26,18 @@
 #include "git/Patch.h"
 #include "git/RevWalk.h"
 #include "git/Signature.h"
+#include "git/StatusCache.h"
 #include "git/TagRef.h"
 #include "git/Tree.h"
 #include <QAbstractListModel>
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QMenu>
 #include <QPainter>
 #include <QPushButton>
 #include <QStyledItemDelegate>
 #include <QTextLayout>
+#include <QTimer>
 #include <QtConcurrent>
 
 namespace {
@@ -43,6 +47,16 @@ const QColor kTaintedColor = Qt::gray;
 
 const QString kPathspecFmt = "pathspec:%1";
 
+// Load batches of commits until either limit is reached.
+const int kFetchLimit = 256;
+const int kFetchBudget = 20; // ms
+
+// Filtered walks run on a worker and report back periodically.
+const int kScanBudget = 100; // ms
+
+// Give up on rename detection in the status after this long.
+const int kSimilarBudget = 2000; // ms
+
 // Use fixed short id size in compact mode.
 // FIXME: Use 'core.abbrev' config instead?
 const int kShortIdSize = 7;
@@ -52,7 +66,12 @@ enum Role
   DiffRole = Qt::UserRole,
   CommitRole,
   GraphRole,
-  GraphColorRole
+  GraphColorRole,
+  SummaryRole,
+  AuthorRole,
+  TimestampRole,
+  IdRole,
+  ShortIdRole
 };
 
 enum GraphSegment
@@ -68,6 +87,70 @@ enum GraphSegment
   RightOut
 };
 
+QString formatTimestamp(const QDateTime &date)
+{
+  return (date.date() == QDate::currentDate()) ?
+    date.time().toString(Qt::DefaultLocaleShortDate) :
+    date.date().toString(Qt::DefaultLocaleShortDate);
+}
+
+// Changes to ignore rules can change the status of any untracked file.
+bool isIgnoreFile(const QString &path)
+{
+  return (path == ".gitignore" || path.endsWith("/.gitignore") ||
+          path == ".git/info/exclude");
+}
+
+// Decoded commit text for painting. This is computed once per row
+// so that the delegate doesn't decode messages or format dates.
+struct Metadata
+{
+  Metadata() {}
+
+  Metadata(const git::Commit &commit)
+    : summary(commit.summary(git::Commit::SubstituteEmoji)),
+      author(commit.author().name()),
+      id(commit.id().toString()),
+      shortId(commit.shortId()),
+      date(commit.committer().date().toLocalTime()),
+      timestamp(formatTimestamp(date)),
+      valid(true)
+  {}
+
+  QVariant data(int role) const
+  {
+    switch (role) {
+      case SummaryRole:
+        return summary;
+      case AuthorRole:
+        return author;
+      case TimestampRole:
+        return timestamp;
+      case IdRole:
+        return id;
+      case ShortIdRole:
+        return shortId;
+    }
+
+    return QVariant();
+  }
+
+  // Reformat after the locale or the current day changes.
+  void updateTimestamp()
+  {
+    if (valid)
+      timestamp = formatTimestamp(date);
+  }
+
+  QString summary;
+  QString author;
+  QString id;
+  QString shortId;
+  QDateTime date;
+  QString timestamp;
+  bool valid = false;
+};
+
 class DiffCallbacks : public git::Diff::Callbacks
 {
 public:
@@ -76,6 +159,11 @@ public:
     mCanceled = canceled;
   }
 
+  bool isCanceled() const
+  {
+    return mCanceled;
+  }
+
   bool progress(const QString &oldPath, const QString &newPath) override
   {
     return !mCanceled;
@@ -98,25 +186,84 @@ public:
       ++mProgress;
       QModelIndex idx = index(0, 0);
       emit dataChanged(idx, idx, {Qt::DisplayRole});
+
+      if (mScanning) {
+        QModelIndex placeholder = index(mRows.size(), 0);
+        emit dataChanged(placeholder, placeholder, {Qt::DisplayRole});
+      }
     });
 
     // Connect watcher to signal when the status diff finishes.
     connect(&mStatus, &QFutureWatcher<git::Diff>::finished, [this] {
-      mTimer.stop();
+      if (!mScanning)
+        mTimer.stop();
       resetWalker();
       emit statusFinished(!mRows.isEmpty() && !mRows.first().commit.isValid());
+      startSimilar();
+    });
+
+    // Connect watcher to update the status when renames are found.
+    connect(&mSimilar, &QFutureWatcher<git::Diff>::finished, [this] {
+      QFuture<git::Diff> future = mSimilar.future();
+      if (!future.resultCount() || !future.result().isValid())
+        return;
+
+      QModelIndex idx = index(0, 0);
+      emit dataChanged(idx, idx);
+      emit statusFinished(!mRows.isEmpty() && !mRows.first().commit.isValid());
     });
 
     git::RepositoryNotifier *notifier = repo.notifier();
     connect(notifier, &git::RepositoryNotifier::referenceUpdated,
             this, &CommitModel::resetReference);
-    connect(notifier, &git::RepositoryNotifier::workdirChanged, [this] {
-      resetReference(mRef);
+    connect(notifier, &git::RepositoryNotifier::workdirChanged,
+    [this](const QStringList &paths) {
+      if (!mRef.isValid() || mRef.isHead())
+        startStatus(paths);
+      resetWalker();
     });
 
+    connect(notifier, &git::RepositoryNotifier::indexRewritten,
+            this, &CommitModel::refreshIndex);
+
+    // Rename detection reads the index. Stop it before the index
+    // changes and try again after the change is finished.
+    connect(notifier, &git::RepositoryNotifier::indexAboutToBeChanged,
+    [this] {
+      if (!cancelSimilar())
+        return;
+
+      QTimer::singleShot(0, this, [this] {
+        if (mStatus.isFinished())
+          startSimilar();
+      });
+    });
+
+    // Connect watcher to add rows when a filtered walk reports back.
+    connect(&mScan, &QFutureWatcher<Scan>::finished,
+            this, &CommitModel::finishScan);
+
     resetSettings();
   }
 
+  ~CommitModel()
+  {
+    // The walks hold on to the repository.
+    mScanCanceled->storeRelease(1);
+    mScan.waitForFinished();
+    foreach (QFuture<Scan> future, mCanceledScans)
+      future.waitForFinished();
+  }
+
+  void updateTimestamps()
+  {
+    for (int i = 0; i < mRows.size(); ++i)
+      mRows[i].metadata.updateTimestamp();
+
+    if (!mRows.isEmpty())
+      emit dataChanged(index(0, 0), index(mRows.size() - 1, 0));
+  }
+
   git::Reference reference() const
   {
     return mRef;
@@ -127,6 +274,13 @@ public:
     if (!mStatus.isFinished())
       return git::Diff();
 
+    // Prefer the status with renames.
+    QFuture<git::Diff> similar = mSimilar.future();
+    if (mSimilar.isFinished() && similar.resultCount()) {
+      if (git::Diff diff = similar.result())
+        return diff;
+    }
+
     QFuture<git::Diff> future = mStatus.future();
     if (!future.resultCount())
       return git::Diff();
@@ -134,26 +288,167 @@ public:
     return future.result();
   }
 
-  void startStatus()
+  // Changed paths limit the diff to those paths and
+  // the paths that were already dirty in the last status.
+  void startStatus(const QStringList &paths = QStringList())
   {
-    // Cancel existing status diff.
+    // Only a finished status can be updated incrementally.
+    git::Diff previous = status();
+    bool finished = (mStatus.isFinished() && !mStatus.future().isCanceled());
+
+    // Cancel existing status diff and discard renames.
     cancelStatus();
+    mSimilar.setFuture(QFuture<git::Diff>());
 
     // Reload the index before starting the status thread. Allowing
     // it to reload on the thread frequently corrupts the index.
-    mRepo.index().read();
+    bool rewritten = mRepo.index().read();
+
+    bool ignore = false;
+    foreach (const QString &path, paths) {
+      if (isIgnoreFile(path)) {
+        ignore = true;
+        break;
+      }
+    }
+
+    QStringList pathspec;
+    if (!paths.isEmpty() && finished && !rewritten && !ignore) {
+      QSet<QString> set = paths.toSet();
+      int count = previous.isValid() ? previous.count() : 0;
+      for (int i = 0; i < count; ++i) {
+        set.insert(previous.name(i));
+        set.insert(previous.name(i, git::Diff::OldFile));
+      }
+
+      pathspec = set.toList();
+    }
 
     // Check for uncommitted changes asynchronously.
     mProgress = 0;
     mTimer.start(50);
-    mStatus.setFuture(QtConcurrent::run([this] {
+    mStatus.setFuture(QtConcurrent::run([this, pathspec]() -> git::Diff {
       // Pass the repo's index to suppress reload.
-      return mRepo.status(mRepo.index(), &mStatusCallbacks);
+      git::Index index = mRepo.index();
+      if (!pathspec.isEmpty())
+        return mRepo.status(index, &mStatusCallbacks, pathspec);
+
+      // Check only the paths that changed since the last full status.
+      QStringList paths;
+      git::StatusCache cache(mRepo);
+      if (cache.changes(index, paths)) {
+        if (paths.isEmpty())
+          return git::Diff();
+        return mRepo.status(index, &mStatusCallbacks, paths);
+      }
+
+      // Record directories first so that later changes aren't missed.
+      cache.record();
+      git::Diff status = mRepo.status(index, &mStatusCallbacks);
+      if (!mStatusCallbacks.isCanceled())
+        cache.save(index, status);
+      return status;
     }));
   }
 
+  // Reload the index after it was rewritten outside of
+  // the app and signal the paths whose staged state changed.
+  void refreshIndex()
+  {
+    // The index can't be reloaded while the status thread reads it.
+    bool running = mStatus.isRunning();
+    bool similar = mSimilar.isRunning();
+    cancelStatus();
+
+    // Read through the status diff's index to update its staged cache.
+    git::Diff diff = status();
+    git::Index index = diff.isValid() ? diff.index() : mRepo.index();
+
+    QStringList paths;
+    index.read(&paths);
+
+    // Entries that were added or removed outside of the app change
+    // which paths are untracked, so update their status too.
+    bool head = (!mRef.isValid() || mRef.isHead());
+    if (running) {
+      startStatus();
+    } else if (!paths.isEmpty() && head) {
+      startStatus(paths);
+    } else if (similar) {
+      startSimilar();
+    }
+
+    if (!paths.isEmpty())
+      emit mRepo.notifier()->indexChanged(paths, false);
+  }
+
+  // Pair deletions with additions after the status is shown. The
+  // dirty paths are diffed again so that the shown status isn't
+  // modified on the worker. Renamed paths collapse into one delta.
+  void startSimilar()
+  {
+    if (mStatus.future().isCanceled())
+      return;
+
+    git::Diff status = this->status();
+    if (!status.isValid())
+      return;
+
+    bool deleted = false;
+    bool added = false;
+    QStringList paths;
+    for (int i = 0; i < status.count(); ++i) {
+      switch (status.status(i)) {
+        case GIT_DELTA_DELETED:
+          deleted = true;
+          break;
+
+        case GIT_DELTA_ADDED:
+        case GIT_DELTA_UNTRACKED:
+          added = true;
+          break;
+
+        default:
+          break;
+      }
+
+      paths.append(status.name(i));
+    }
+
+    if (!deleted || !added)
+      return;
+
+    int count = status.count();
+    mSimilar.setFuture(QtConcurrent::run([this, paths, count]() -> git::Diff {
+      git::Index index = mRepo.index();
+      git::Diff diff = mRepo.status(index, &mSimilarCallbacks, paths);
+      if (!diff.isValid() ||
+          !diff.findSimilar(true, &mSimilarCallbacks, kSimilarBudget) ||
+          diff.count() >= count)
+        return git::Diff();
+
+      return diff;
+    }));
+  }
+
+  // Return true if rename detection was running.
+  bool cancelSimilar()
+  {
+    if (!mSimilar.isRunning())
+      return false;
+
+    // Rename detection has no partial result.
+    mSimilarCallbacks.setCanceled(true);
+    mSimilar.waitForFinished();
+    mSimilar.setFuture(QFuture<git::Diff>());
+    mSimilarCallbacks.setCanceled(false);
+    return true;
+  }
+
   void cancelStatus()
   {
+    cancelSimilar();
+
     if (!mStatus.isRunning())
       return;
 
@@ -199,6 +494,8 @@ public:
     // Reset state.
     mParents.clear();
     mRows.clear();
+    mRowIds.clear();
+    cancelScan();
 
     // Update status row.
     bool head = (!mRef.isValid() || mRef.isHead());
@@ -214,40 +511,19 @@ public:
     }
 
     // Begin walking commits.
-    if (mRef.isValid()) {
-      int sort = GIT_SORT_NONE;
-      if (mGraphVisible) {
-        sort |= GIT_SORT_TOPOLOGICAL;
-        if (mSortDate)
-          sort |= GIT_SORT_TIME;
-      } else if (!mSortDate) {
-        sort |= GIT_SORT_TOPOLOGICAL;
-      }
+    mWalker = walker();
 
-      mWalker = mRef.walker(sort);
-      if (mRef.isLocalBranch()) {
-        // Add the upstream branch.
-        if (git::Branch upstream = git::Branch(mRef).upstream())
-          mWalker.push(upstream);
-      }
-
-      if (mRef.isHead()) {
-        // Add merge head.
-        if (git::Reference mergeHead = mRepo.lookupRef("MERGE_HEAD"))
-          mWalker.push(mergeHead);
-      }
-
-      if (mRefsAll) {
-        foreach (const git::Reference ref, mRepo.refs()) {
-          if (!ref.isStash())
-            mWalker.push(ref);
-        }
+    if (mWalker.isValid()) {
+      if (mPathspec.isEmpty()) {
+        fetch(kFetchLimit, kFetchBudget);
+      } else {
+        // Start with only the placeholder row.
+        mScanning = true;
+        mScanTarget = 0;
+        scan();
       }
     }
 
-    if (canFetchMore(QModelIndex()))
-      fetchMore(QModelIndex());
-
     endResetModel();
   }
 
@@ -265,82 +541,104 @@ public:
 
   bool canFetchMore(const QModelIndex &parent) const
   {
-    return mWalker.isValid();
+    return mWalker.isValid() && !mScanning;
   }
 
   void fetchMore(const QModelIndex &parent)
   {
-    // Load commits.
-    int i = 0;
-    QList<Row> rows;
-    git::Commit commit = mWalker.next(mPathspec);
-    while (commit.isValid()) {
-      // Add root commits.
-      bool root = false;
-      if (indexOf(commit) < 0) {
-        root = true;
-        mParents.append(Parent(commit, nextColor()));
-      }
+    if (mPathspec.isEmpty()) {
+      fetch(kFetchLimit, kFetchBudget);
+      return;
+    }
 
-      // Calculate graph columns.
-      // Remember current row.
-      QList<Parent> parents = mParents;
+    // A filtered walk may have to diff many commits to find a match.
+    // Search on a worker behind a placeholder row instead.
+    mScanTarget = mRows.size() + kFetchLimit;
+    beginInsertRows(QModelIndex(), mRows.size(), mRows.size());
+    mScanning = true;
+    endInsertRows();
 
-      // Replace commit with its parents.
-      QList<git::Commit> replacements;
-      foreach (const git::Commit &parent, commit.parents()) {
-        // FIXME: Mark commits that point to existing parent?
-        if (indexOf(parent) < 0 && !contains(parent, rows))
-          replacements.append(parent);
-      }
+    scan();
+  }
 
-      // Set parents for next row.
-      int index = indexOf(commit);
-      if (index >= 0) {
-        Parent parent = mParents.takeAt(index);
-        if (!replacements.isEmpty()) {
-          git::Commit replacement = replacements.takeFirst();
-          mParents.insert(index, Parent(replacement, parent.color));
-          foreach (const git::Commit &replacement, replacements)
-            mParents.append(Parent(replacement, nextColor()));
-        }
-      }
+  Qt::ItemFlags flags(const QModelIndex &index) const
+  {
+    // The placeholder can't be selected.
+    if (index.row() >= mRows.size())
+      return Qt::NoItemFlags;
 
-      // Add graph row.
-      QVector<Column> row;
-      if (mGraphVisible && mPathspec.isEmpty())
-        row = columns(commit, parents, root);
+    return QAbstractListModel::flags(index);
+  }
 
-      rows.append(Row(commit, row));
+  // Get the row of the commit, loading rows up to it if necessary.
+  int findRow(const git::Commit &commit)
+  {
+    int row = mRowIds.value(commit.id(), -1);
+    if (row >= 0 || !mWalker.isValid())
+      return row;
 
-      // Bail out.
-      if (i++ >= 64)
+    // Take the walker back from the worker.
+    stopScan();
+
+    // Run ahead with a separate walker that doesn't lay out rows to find
+    // out how far away the commit is. Count matches of the same pathspec
+    // from the start of history. Cut off at the first older commit.
+    int count = 0;
+    bool found = false;
+    QDateTime date = commit.committer().date();
+    git::RevWalk walker = this->walker();
+    while (git::Commit next = walker.next(mPathspec)) {
+      ++count;
+      if (next == commit) {
+        found = true;
         break;
+      }
 
-      commit = mWalker.next(mPathspec);
+      if (next.committer().date() < date)
+        break;
     }
 
-    // Update the model.
-    if (!rows.isEmpty()) {
-      int first = mRows.size();
-      int last = first + rows.size() - 1;
-      beginInsertRows(QModelIndex(), first, last);
-      mRows.append(rows);
-      endInsertRows();
-    }
+    if (!found)
+      return -1;
 
-    // Invalidate walker.
-    if (!commit.isValid())
-      mWalker = git::RevWalk();
+    // Load the remaining rows in one batch. The model's walker
+    // continues from the last loaded commit. Skip the status row.
+    bool status = (!mRows.isEmpty() && !mRows.first().commit.isValid());
+    int loaded = mRows.size() - (status ? 1 : 0);
+    if (count > loaded)
+      fetch(count - loaded);
+    return mRowIds.value(commit.id(), -1);
   }
 
   int rowCount(const QModelIndex &parent = QModelIndex()) const
   {
-    return mRows.size();
+    return mRows.size() + (mScanning ? 1 : 0);
   }
 
   QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const
   {
+    // Show a placeholder while a filtered walk is still searching.
+    if (index.row() >= mRows.size()) {
+      switch (role) {
+        case Qt::DisplayRole:
+          return tr("Scanning history...");
+
+        case Qt::FontRole: {
+          QFont font = static_cast<QWidget *>(QObject::parent())->font();
+          font.setItalic(true);
+          return font;
+        }
+
+        case Qt::TextAlignmentRole:
+          return QVariant(Qt::AlignHCenter | Qt::AlignVCenter);
+
+        case Qt::DecorationRole:
+          return mProgress;
+      }
+
+      return QVariant();
+    }
+
     const Row &row = mRows.at(index.row());
     bool status = !row.commit.isValid();
     switch (role) {
@@ -372,18 +670,20 @@ public:
 
         return mStatus.isFinished() ? QVariant() : mProgress;
 
-      case DiffRole: {
-        if (status)
-          return QVariant::fromValue(this->status());
-
-        git::Diff diff = row.commit.diff();
-        diff.findSimilar();
-        return QVariant::fromValue(diff);
-      }
+      case DiffRole:
+        // Commit diffs come from the diff cache.
+        return status ? QVariant::fromValue(this->status()) : QVariant();
 
       case CommitRole:
         return status ? QVariant() : QVariant::fromValue(row.commit);
 
+      case TimestampRole:
+      case SummaryRole:
+      case AuthorRole:
+      case IdRole:
+      case ShortIdRole:
+        return row.metadata.data(role);
+
       case GraphRole: {
         QVariantList columns;
         foreach (const Column &column, row.columns) {
@@ -447,16 +747,262 @@ private:
 
   using Column = QList<Segment>;
 
+  struct Scan
+  {
+    QList<git::Commit> commits;
+    bool finished = false;
+  };
+
   struct Row
   {
-    Row(const git::Commit &commit, const QVector<Column> &columns)
-      : commit(commit), columns(columns)
+    Row(
+      const git::Commit &commit,
+      const QVector<Column> &columns,
+      const Metadata &metadata = Metadata())
+      : commit(commit), columns(columns), metadata(metadata)
     {}
 
     git::Commit commit;
     QVector<Column> columns;
+    Metadata metadata;
   };
 
+  // Load up to limit commits or until the time budget runs out.
+  void fetch(int limit, int budget = -1)
+  {
+    QElapsedTimer timer;
+    timer.start();
+
+    int i = 0;
+    QList<Row> rows;
+    git::Commit commit = mWalker.next(mPathspec);
+    while (commit.isValid()) {
+      layout(commit, rows);
+
+      // Bail out.
+      if (++i >= limit || (budget >= 0 && timer.elapsed() >= budget))
+        break;
+
+      commit = mWalker.next(mPathspec);
+    }
+
+    insertRows(rows);
+
+    // Invalidate walker.
+    if (!commit.isValid())
+      mWalker = git::RevWalk();
+  }
+
+  // Lay out the graph row for the next commit.
+  void layout(const git::Commit &commit, QList<Row> &rows)
+  {
+    // Add root commits.
+    bool root = false;
+    if (indexOf(commit) < 0) {
+      root = true;
+      mParents.append(Parent(commit, nextColor()));
+    }
+
+    // Calculate graph columns.
+    // Remember current row.
+    QList<Parent> parents = mParents;
+
+    // Replace commit with its parents.
+    QList<git::Commit> replacements;
+    foreach (const git::Commit &parent, commit.parents()) {
+      // FIXME: Mark commits that point to existing parent?
+      if (indexOf(parent) < 0 && !contains(parent, rows))
+        replacements.append(parent);
+    }
+
+    // Set parents for next row.
+    int index = indexOf(commit);
+    if (index >= 0) {
+      Parent parent = mParents.takeAt(index);
+      if (!replacements.isEmpty()) {
+        git::Commit replacement = replacements.takeFirst();
+        mParents.insert(index, Parent(replacement, parent.color));
+        foreach (const git::Commit &replacement, replacements)
+          mParents.append(Parent(replacement, nextColor()));
+      }
+    }
+
+    // Add graph row.
+    QVector<Column> row;
+    if (mGraphVisible && mPathspec.isEmpty())
+      row = columns(commit, parents, root);
+
+    rows.append(Row(commit, row, Metadata(commit)));
+  }
+
+  // Insert rows before the placeholder.
+  void insertRows(const QList<Row> &rows)
+  {
+    if (rows.isEmpty())
+      return;
+
+    int first = mRows.size();
+    int last = first + rows.size() - 1;
+    beginInsertRows(QModelIndex(), first, last);
+    for (int i = 0; i < rows.size(); ++i)
+      mRowIds.insert(rows.at(i).commit.id(), first + i);
+    mRows.append(rows);
+    endInsertRows();
+  }
+
+  // Continue the filtered walk on a worker. The worker owns
+  // the walker until it reports back.
+  void scan()
+  {
+    if (!mTimer.isActive())
+      mTimer.start(50);
+
+    git::RevWalk walker = mWalker;
+    walker.setBuildFilters(true);
+    QString pathspec = mPathspec;
+    QSharedPointer<QAtomicInt> canceled = mScanCanceled;
+    mScan.setFuture(QtConcurrent::run([walker, pathspec, canceled] {
+      Scan result;
+      QElapsedTimer timer;
+      timer.start();
+
+      // Check between commits inside the walk too. A single
+      // match can be thousands of commits away.
+      auto interrupt = [&timer, canceled] {
+        return canceled->loadAcquire() || timer.elapsed() >= kScanBudget;
+      };
+
+      while (result.commits.size() < kFetchLimit && !interrupt()) {
+        git::Commit commit = walker.next(pathspec, interrupt);
+        if (!commit.isValid()) {
+          result.finished = !interrupt();
+          break;
+        }
+
+        result.commits.append(commit);
+      }
+
+      return result;
+    }));
+  }
+
+  void finishScan()
+  {
+    if (!mScanning)
+      return;
+
+    takeScan();
+
+    // Keep scanning a batch ahead of the last request.
+    if (mWalker.isValid() && mRows.size() < mScanTarget + kFetchLimit) {
+      scan();
+      return;
+    }
+
+    endScan();
+  }
+
+  // Add the rows that the worker found.
+  void takeScan()
+  {
+    QFuture<Scan> future = mScan.future();
+    Scan result = future.resultCount() ? future.result() : Scan();
+
+    QList<Row> rows;
+    foreach (const git::Commit &commit, result.commits)
+      layout(commit, rows);
+    insertRows(rows);
+
+    if (result.finished)
+      mWalker = git::RevWalk();
+  }
+
+  // Interrupt the worker and add its rows without continuing.
+  void stopScan()
+  {
+    if (!mScanning)
+      return;
+
+    mScanCanceled->storeRelease(1);
+    mScan.waitForFinished();
+    mScanCanceled = QSharedPointer<QAtomicInt>(new QAtomicInt);
+
+    mScanTarget = 0;
+    takeScan();
+    endScan();
+  }
+
+  // Abandon the walk. Called from within a model reset.
+  void cancelScan()
+  {
+    mScanCanceled->storeRelease(1);
+    mScanCanceled = QSharedPointer<QAtomicInt>(new QAtomicInt);
+
+    // Remember the worker so that it can be waited on later.
+    QList<QFuture<Scan>> canceled;
+    foreach (QFuture<Scan> future, mCanceledScans) {
+      if (!future.isFinished())
+        canceled.append(future);
+    }
+
+    QFuture<Scan> future = mScan.future();
+    if (!future.isFinished())
+      canceled.append(future);
+
+    mCanceledScans = canceled;
+    mScan.setFuture(QFuture<Scan>());
+    mScanning = false;
+
+    if (mStatus.isFinished())
+      mTimer.stop();
+  }
+
+  // Remove the placeholder.
+  void endScan()
+  {
+    beginRemoveRows(QModelIndex(), mRows.size(), mRows.size());
+    mScanning = false;
+    endRemoveRows();
+
+    if (mStatus.isFinished())
+      mTimer.stop();
+  }
+
+  git::RevWalk walker() const
+  {
+    if (!mRef.isValid())
+      return git::RevWalk();
+
+    int sort = GIT_SORT_NONE;
+    if (mGraphVisible) {
+      sort |= GIT_SORT_TOPOLOGICAL;
+      if (mSortDate)
+        sort |= GIT_SORT_TIME;
+    } else if (!mSortDate) {
+      sort |= GIT_SORT_TOPOLOGICAL;
+    }
+
+    git::RevWalk walker = mRef.walker(sort);
+    if (mRef.isLocalBranch()) {
+      // Add the upstream branch.
+      if (git::Branch upstream = git::Branch(mRef).upstream())
+        walker.push(upstream);
+    }
+
+    if (mRef.isHead()) {
+      // Add merge head.
+      if (git::Reference mergeHead = mRepo.lookupRef("MERGE_HEAD"))
+        walker.push(mergeHead);
+    }
+
+    if (mRefsAll) {
+      foreach (const git::Id &id, mRepo.refTargets(false))
+        walker.push(id);
+    }
+
+    return walker;
+  }
+
   int indexOf(const git::Commit &commit) const
   {
     int count = mParents.size();
@@ -470,10 +1016,8 @@ private:
 
   bool contains(const git::Commit &commit, const QList<Row> &rows) const
   {
-    foreach (const Row &row, mRows) {
-      if (row.commit == commit)
-        return true;
-    }
+    if (mRowIds.contains(commit.id()))
+      return true;
 
     foreach (const Row &row, rows) {
       if (row.commit == commit)
@@ -582,6 +1126,10 @@ private:
   DiffCallbacks mStatusCallbacks;
   QFutureWatcher<git::Diff> mStatus;
 
+  // rename detection
+  DiffCallbacks mSimilarCallbacks;
+  QFutureWatcher<git::Diff> mSimilar;
+
   QString mPathspec;
   git::Reference mRef;
   git::RevWalk mWalker;
@@ -589,6 +1137,15 @@ private:
 
   QList<Row> mRows;
   QList<Parent> mParents;
+  QHash<git::Id,int> mRowIds;
+
+  // filtered walk
+  QFutureWatcher<Scan> mScan;
+  QList<QFuture<Scan>> mCanceledScans;
+  QSharedPointer<QAtomicInt> mScanCanceled =
+    QSharedPointer<QAtomicInt>(new QAtomicInt);
+  bool mScanning = false;
+  int mScanTarget = 0;
 
   // walker settings
   bool mRefsAll = true;
@@ -608,9 +1165,19 @@ public:
   {
     beginResetModel();
     mCommits = commits;
+    mMetadata = QVector<Metadata>(commits.size());
     endResetModel();
   }
 
+  void updateTimestamps()
+  {
+    for (int i = 0; i < mMetadata.size(); ++i)
+      mMetadata[i].updateTimestamp();
+
+    if (!mCommits.isEmpty())
+      emit dataChanged(index(0, 0), index(mCommits.size() - 1, 0));
+  }
+
   int rowCount(const QModelIndex &parent = QModelIndex()) const override
   {
     return mCommits.size();
@@ -621,14 +1188,20 @@ public:
     int role = Qt::DisplayRole) const override
   {
     switch (role) {
-      case DiffRole: {
-        git::Diff diff = mCommits.at(index.row()).diff();
-        diff.findSimilar();
-        return QVariant::fromValue(diff);
-      }
-
       case CommitRole:
         return QVariant::fromValue(mCommits.at(index.row()));
+
+      case TimestampRole:
+      case SummaryRole:
+      case AuthorRole:
+      case IdRole:
+      case ShortIdRole: {
+        // Search results can be long. Decode them lazily.
+        Metadata &metadata = mMetadata[index.row()];
+        if (!metadata.valid)
+          metadata = Metadata(mCommits.at(index.row()));
+        return metadata.data(role);
+      }
     }
 
     return QVariant();
@@ -636,6 +1209,8 @@ public:
 
 private:
   QList<git::Commit> mCommits;
+  mutable QVector<Metadata> mMetadata;
+
 };
 
 class CommitDelegate : public QStyledItemDelegate
@@ -817,10 +1392,7 @@ public:
       const QFontMetrics &fm = opt.fontMetrics;
       QRect star = rect;
 
-      QDateTime date = commit.committer().date().toLocalTime();
-      QString timestamp = (date.date() == QDate::currentDate()) ?
-        date.time().toString(Qt::DefaultLocaleShortDate) :
-        date.date().toString(Qt::DefaultLocaleShortDate);
+      QString timestamp = index.data(TimestampRole).toString();
       int timestampWidth = fm.horizontalAdvance(timestamp);
 
       if (compact) {
@@ -835,7 +1407,7 @@ public:
         rect.setWidth(rect.width() - star.width());
 
         // Draw commit id.
-        QString id = commit.id().toString().left(kShortIdSize);
+        QString id = index.data(IdRole).toString().left(kShortIdSize);
         int idWidth = maxShortIdWidth(fm);
 
         QRect commitRect = rect;
@@ -865,7 +1437,7 @@ public:
 
         // Draw references.
         int badgesWidth = rect.x();
-        QList<Badge::Label> refs = mRefs.value(commit.id());
+        QList<Badge::Label> refs = labels(commit.id());
         if (!refs.isEmpty())
           badgesWidth = Badge::paint(painter, refs, ref, &opt, Qt::AlignLeft);
         rect.setX(badgesWidth); // Comes right after the badges
@@ -873,14 +1445,14 @@ public:
         // Draw message.
         painter->save();
         painter->setPen(bright);
-        QString msg = commit.summary(git::Commit::SubstituteEmoji);
+        QString msg = index.data(SummaryRole).toString();
         QString elidedText = fm.elidedText(msg, Qt::ElideRight, rect.width());
         painter->drawText(rect, Qt::ElideRight, elidedText);
         painter->restore();
 
       } else {
         // Draw Name.
-        QString name = commit.author().name();
+        QString name = index.data(AuthorRole).toString();
         painter->save();
         QFont bold = opt.font;
         bold.setBold(true);
@@ -899,13 +1471,13 @@ public:
         rect.setY(rect.y() + constants.lineSpacing + constants.vMargin);
 
         // Draw id.
-        QString id = commit.shortId();
+        QString id = index.data(ShortIdRole).toString();
         painter->save();
         painter->drawText(rect, Qt::AlignLeft, id);
         painter->restore();
 
         // Draw references.
-        QList<Badge::Label> refs = mRefs.value(commit.id());
+        QList<Badge::Label> refs = labels(commit.id());
         if (!refs.isEmpty()) {
           QRect refsRect = rect;
           refsRect.setX(refsRect.x() + fm.boundingRect(id).width() + 6);
@@ -923,7 +1495,7 @@ public:
         // Draw message.
         painter->save();
         painter->setPen(bright);
-        QString msg = commit.summary(git::Commit::SubstituteEmoji);
+        QString msg = index.data(SummaryRole).toString();
         QTextLayout layout(msg, painter->font());
         layout.beginLayout();
 
@@ -1082,17 +1654,32 @@ private:
 
   void updateRefs()
   {
+    // Labels are looked up lazily from the repository's ref snapshot.
     mRefs.clear();
+    mHead = git::Reference();
+    mHeadTarget = git::Id();
 
     if (mRepo.isHeadDetached()) {
-      git::Reference head = mRepo.head();
-      mRefs[head.target().id()].append({head.name(), true});
+      mHead = mRepo.head();
+      mHeadTarget = mHead.target().id();
     }
+  }
 
-    foreach (const git::Reference &ref, mRepo.refs()) {
-      if (git::Commit target = ref.target())
-        mRefs[target.id()].append({ref.name(), ref.isHead(), ref.isTag()});
-    }
+  QList<Badge::Label> labels(const git::Id &id) const
+  {
+    auto it = mRefs.constFind(id);
+    if (it != mRefs.constEnd())
+      return it.value();
+
+    QList<Badge::Label> refs;
+    if (mHead.isValid() && mHeadTarget == id)
+      refs.append({mHead.name(), true});
+
+    foreach (const git::Reference &ref, mRepo.lookupRefs(id))
+      refs.append({ref.name(), ref.isHead(), ref.isTag()});
+
+    mRefs.insert(id, refs);
+    return refs;
   }
 
   int maxShortIdWidth(const QFontMetrics &fm) const
@@ -1113,7 +1700,9 @@ private:
   }
 
   git::Repository mRepo;
-  QMap<git::Id,QList<Badge::Label>> mRefs;
+  git::Reference mHead;
+  git::Id mHeadTarget;
+  mutable QHash<git::Id,QList<Badge::Label>> mRefs;
 
   mutable int mMaxShortIdWidth = -1;
 };
@@ -1152,6 +1741,10 @@ CommitList::CommitList(Index *index, QWidget *parent)
   mList = new ListModel(this);
   mModel = new CommitModel(repo, this);
 
+  mDiffs = new DiffCache(this);
+  connect(mDiffs, &DiffCache::diffReady,
+          this, &CommitList::notifyDiffReady);
+
   setMouseTracking(true);
   setUniformItemSizes(true);
   setAttribute(Qt::WA_MacShowFocusRect, false);
@@ -1187,6 +1780,20 @@ CommitList::CommitList(Index *index, QWidget *parent)
     update(index);
   });
 
+  connect(Settings::instance(), &Settings::settingsChanged,
+          this, &CommitList::updateTimestamps);
+
+  // Dates are formatted relative to the current day.
+  mDayTimer = new QTimer(this);
+  mDayTimer->setSingleShot(true);
+  mDayTimer->setTimerType(Qt::PreciseTimer);
+  connect(mDayTimer, &QTimer::timeout, [this] {
+    updateTimestamps();
+    startDayTimer();
+  });
+
+  startDayTimer();
+
   git::RepositoryNotifier *notifier = repo.notifier();
   connect(notifier, &git::RepositoryNotifier::referenceUpdated,
   [this](const git::Reference &ref) {
@@ -1238,17 +1845,18 @@ git::Diff CommitList::selectedDiff() const
   if (indexes.isEmpty())
     return git::Diff();
 
-  if (indexes.size() == 1)
-    return indexes.first().data(DiffRole).value<git::Diff>();
-
   git::Commit first = indexes.first().data(CommitRole).value<git::Commit>();
-  if (!first.isValid())
+  if (!first.isValid()) {
+    if (indexes.size() == 1)
+      return indexes.first().data(DiffRole).value<git::Diff>();
     return git::Diff();
+  }
+
+  git::Commit last;
+  if (indexes.size() > 1)
+    last = indexes.last().data(CommitRole).value<git::Commit>();
 
-  git::Commit last = indexes.last().data(CommitRole).value<git::Commit>();
-  git::Diff diff = first.diff(last);
-  diff.findSimilar();
-  return diff;
+  return mDiffs->diff(first, last);
 }
 
 QList<git::Commit> CommitList::selectedCommits() const
@@ -1320,9 +1928,10 @@ void CommitList::resetSelection(bool spontaneous)
 void CommitList::selectFirstCommit(bool spontaneous)
 {
   QModelIndex index = model()->index(0, 0);
-  if (index.isValid()) {
+  if (index.isValid() && (index.flags() & Qt::ItemIsSelectable)) {
     selectIndexes(QItemSelection(index, index), QString(), spontaneous);
   } else {
+    mDiffPending = false;
     emit diffSelected(git::Diff());
   }
 }
@@ -1656,6 +2265,14 @@ void CommitList::leaveEvent(QEvent *event)
   QListView::leaveEvent(event);
 }
 
+void CommitList::changeEvent(QEvent *event)
+{
+  if (event->type() == QEvent::LocaleChange)
+    updateTimestamps();
+
+  QListView::changeEvent(event);
+}
+
 void CommitList::storeSelection()
 {
   mSelectedRange = selectedRange();
@@ -1664,12 +2281,28 @@ void CommitList::storeSelection()
 void CommitList::restoreSelection()
 {
   // Restore selection.
-  if (!mSelectedRange.isEmpty() && !selectRange(mSelectedRange))
+  if (!mSelectedRange.isEmpty() && !selectRange(mSelectedRange)) {
+    mDiffPending = false;
     emit diffSelected(git::Diff());
+  }
 
   mSelectedRange = QString();
 }
 
+void CommitList::updateTimestamps()
+{
+  static_cast<CommitModel *>(mModel)->updateTimestamps();
+  static_cast<ListModel *>(mList)->updateTimestamps();
+}
+
+void CommitList::startDayTimer()
+{
+  // Fire shortly after midnight.
+  QDateTime now = QDateTime::currentDateTime();
+  QDateTime midnight(now.date().addDays(1), QTime(0, 0));
+  mDayTimer->start(qMax(now.msecsTo(midnight), qint64(0)) + 1000);
+}
+
 void CommitList::updateModel()
 {
   if (!mFilter.isEmpty()) {
@@ -1705,7 +2338,14 @@ QModelIndex CommitList::findCommit(const git::Commit &commit)
   if (!commit.isValid()) {
     QModelIndex index = model->index(0, 0);
     git::Commit tmp = index.data(CommitRole).value<git::Commit>();
-    return !tmp.isValid() ? index : QModelIndex();
+    bool selectable = (index.flags() & Qt::ItemIsSelectable);
+    return (!tmp.isValid() && selectable) ? index : QModelIndex();
+  }
+
+  // Look up the row directly.
+  if (model == mModel) {
+    int row = static_cast<CommitModel *>(mModel)->findRow(commit);
+    return (row >= 0) ? model->index(row, 0) : QModelIndex();
   }
 
   // Find the id.
@@ -1757,7 +2397,66 @@ void CommitList::notifySelectionChanged()
   foreach (const QModelIndex &index, indexes)
     update(index);
 
-  emit diffSelected(selectedDiff(), mFile, mSpontaneous);
+  // Report the status diff and cached diffs immediately.
+  mDiffPending = false;
+  QModelIndexList sorted = sortedIndexes();
+  QModelIndex index = sorted.first();
+  git::Commit first = index.data(CommitRole).value<git::Commit>();
+  git::Commit last;
+  if (sorted.size() > 1)
+    last = sorted.last().data(CommitRole).value<git::Commit>();
+
+  if (!first.isValid() || (sorted.size() > 1 && !last.isValid())) {
+    emit diffSelected(selectedDiff(), mFile, mSpontaneous);
+    return;
+  }
+
+  // Compute the selected diff and speculatively
+  // precompute the diffs of adjacent commits.
+  QList<DiffCache::Request> requests;
+  requests.append(DiffCache::Request(first, last));
+  if (sorted.size() == 1) {
+    for (int offset = 1; offset >= -1; offset -= 2) {
+      QModelIndex adjacent = model()->index(index.row() + offset, 0);
+      git::Commit commit = adjacent.data(CommitRole).value<git::Commit>();
+      if (commit.isValid())
+        requests.append(DiffCache::Request(commit, git::Commit()));
+    }
+  }
+
+  git::Diff diff = mDiffs->cachedDiff(first, last);
+  mDiffs->fetch(requests);
+  if (diff.isValid()) {
+    emit diffSelected(diff, mFile, mSpontaneous);
+    return;
+  }
+
+  mDiffPending = true;
+  mDiffFile = mFile;
+  mDiffSpontaneous = mSpontaneous;
+}
+
+void CommitList::notifyDiffReady()
+{
+  if (!mDiffPending)
+    return;
+
+  QModelIndexList indexes = sortedIndexes();
+  if (indexes.isEmpty())
+    return;
+
+  git::Commit first = indexes.first().data(CommitRole).value<git::Commit>();
+  git::Commit last;
+  if (indexes.size() > 1)
+    last = indexes.last().data(CommitRole).value<git::Commit>();
+
+  // Wait for the selected diff. Fall back to computing it here
+  // if it failed in the background.
+  if (mDiffs->isPending(first, last))
+    return;
+
+  mDiffPending = false;
+  emit diffSelected(mDiffs->diff(first, last), mDiffFile, mDiffSpontaneous);
 }
 
 bool CommitList::isDecoration(const QModelIndex &index, const QPoint &pos)
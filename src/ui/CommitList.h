@@ -13,7 +13,9 @@
 #include "git/Reference.h"
 #include <QListView>
 
+class DiffCache;
 class Index;
+class QTimer;
 
 namespace git {
 class Commit;
@@ -68,11 +70,14 @@ protected:
   void mousePressEvent(QMouseEvent *event) override;
   void mouseReleaseEvent(QMouseEvent *event) override;
   void leaveEvent(QEvent *) override;
+  void changeEvent(QEvent *event) override;
 
 private:
   void storeSelection();
   void restoreSelection();
   void updateModel();
+  void updateTimestamps();
+  void startDayTimer();
 
   QModelIndexList sortedIndexes() const;
 
@@ -83,6 +88,7 @@ private:
     bool spontaneous = false);
 
   void notifySelectionChanged();
+  void notifyDiffReady();
 
   bool isDecoration(const QModelIndex &index, const QPoint &pos);
   bool isStar(const QModelIndex &index, const QPoint &pos);
@@ -98,7 +104,17 @@ private:
   QAbstractListModel *mList;
   QAbstractListModel *mModel;
 
+  // Commit diffs are computed in the background. The selection
+  // is announced when the diff for the current selection is ready.
+  DiffCache *mDiffs;
+  bool mDiffPending = false;
+  QString mDiffFile;
+  bool mDiffSpontaneous = true;
+
   QString mSelectedRange;
+
+  // Update timestamps when the day changes.
+  QTimer *mDayTimer;
 };
 
 #endif
@@ -0,0 +1,213 @@
+//
+//          Copyright (c) 2016, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#include "DiffCache.h"
+#include "conf/Settings.h"
+#include "git/Tree.h"
+#include <QAtomicInt>
+#include <QTimer>
+#include <QtConcurrent>
+
+namespace {
+
+const int kCacheSize = 16;
+
+class DiffCallbacks : public git::Diff::Callbacks
+{
+public:
+  void cancel()
+  {
+    mCanceled.storeRelease(1);
+  }
+
+  bool isCanceled() const
+  {
+    return mCanceled.loadAcquire();
+  }
+
+  bool progress(const QString &oldPath, const QString &newPath) override
+  {
+    return !isCanceled();
+  }
+
+private:
+  QAtomicInt mCanceled;
+};
+
+} // anon. namespace
+
+class DiffCache::Job
+{
+public:
+  QFutureWatcher<git::Diff> watcher;
+  DiffCallbacks callbacks;
+};
+
+uint qHash(const DiffCache::Key &key)
+{
+  return qHash(key.oldTree) ^ qHash(key.newTree) ^ uint(key.ignoreWhitespace);
+}
+
+DiffCache::DiffCache(QObject *parent)
+  : QObject(parent)
+{}
+
+DiffCache::~DiffCache()
+{
+  QList<Job *> jobs = mJobs.values() + mCanceledJobs;
+  foreach (Job *job, jobs) {
+    job->callbacks.cancel();
+    job->watcher.waitForFinished();
+  }
+
+  qDeleteAll(jobs);
+}
+
+git::Diff DiffCache::cachedDiff(
+  const git::Commit &commit,
+  const git::Commit &base)
+{
+  Key key = this->key(commit, base);
+  git::Diff diff = mDiffs.value(key);
+  if (diff.isValid()) {
+    // Move to the front.
+    mKeys.removeOne(key);
+    mKeys.prepend(key);
+  }
+
+  return diff;
+}
+
+git::Diff DiffCache::diff(const git::Commit &commit, const git::Commit &base)
+{
+  if (git::Diff diff = cachedDiff(commit, base))
+    return diff;
+
+  // Wait for the pending request.
+  Key key = this->key(commit, base);
+  if (Job *job = mJobs.value(key)) {
+    job->watcher.waitForFinished();
+    finish(key, job);
+    if (git::Diff diff = mDiffs.value(key))
+      return diff;
+  }
+
+  git::Diff diff = commit.diff(base);
+  if (diff.isValid()) {
+    diff.findSimilar();
+    insert(key, diff);
+  }
+
+  return diff;
+}
+
+bool DiffCache::isPending(
+  const git::Commit &commit,
+  const git::Commit &base) const
+{
+  return mJobs.contains(key(commit, base));
+}
+
+void DiffCache::fetch(const QList<Request> &requests)
+{
+  QList<Key> keys;
+  foreach (const Request &request, requests)
+    keys.append(key(request.first, request.second));
+
+  // Cancel requests that are no longer wanted.
+  foreach (const Key &key, mJobs.keys()) {
+    if (!keys.contains(key)) {
+      Job *job = mJobs.take(key);
+      job->callbacks.cancel();
+      mCanceledJobs.append(job);
+    }
+  }
+
+  for (int i = 0; i < requests.size(); ++i) {
+    const Key &key = keys.at(i);
+    if (mDiffs.contains(key) || mJobs.contains(key))
+      continue;
+
+    Job *job = new Job;
+    connect(&job->watcher, &QFutureWatcher<git::Diff>::finished, this,
+    [this, key, job] {
+      finish(key, job);
+    });
+
+    git::Commit commit = requests.at(i).first;
+    git::Commit base = requests.at(i).second;
+    DiffCallbacks *callbacks = &job->callbacks;
+    job->watcher.setFuture(QtConcurrent::run([commit, base, callbacks] {
+      git::Diff diff = commit.diff(base, -1, callbacks);
+      if (!diff.isValid() || callbacks->isCanceled())
+        return git::Diff();
+
+      // Rename detection can't be interrupted.
+      diff.findSimilar();
+      return diff;
+    }));
+
+    mJobs.insert(key, job);
+  }
+}
+
+DiffCache::Key DiffCache::key(
+  const git::Commit &commit,
+  const git::Commit &base) const
+{
+  git::Tree old;
+  if (base.isValid()) {
+    old = base.tree();
+  } else {
+    QList<git::Commit> parents = commit.parents();
+    if (!parents.isEmpty())
+      old = parents.first().tree();
+  }
+
+  Key key;
+  key.oldTree = old.isValid() ? git::Object(old).id() : git::Id();
+  key.newTree = git::Object(commit.tree()).id();
+  key.ignoreWhitespace = Settings::instance()->isWhitespaceIgnored();
+  return key;
+}
+
+void DiffCache::insert(const Key &key, const git::Diff &diff)
+{
+  mKeys.removeOne(key);
+  mKeys.prepend(key);
+  mDiffs.insert(key, diff);
+
+  while (mKeys.size() > kCacheSize)
+    mDiffs.remove(mKeys.takeLast());
+}
+
+void DiffCache::finish(const Key &key, Job *job)
+{
+  bool canceled = mCanceledJobs.removeOne(job);
+  if (!canceled) {
+    if (mJobs.value(key) != job)
+      return;
+
+    mJobs.remove(key);
+  }
+
+  // Don't delete the watcher from its own signal.
+  job->watcher.disconnect(this);
+  QTimer::singleShot(0, [job] { delete job; });
+
+  if (canceled)
+    return;
+
+  QFuture<git::Diff> future = job->watcher.future();
+  git::Diff diff = future.resultCount() ? future.result() : git::Diff();
+  if (diff.isValid())
+    insert(key, diff);
+
+  emit diffReady();
+}
@@ -0,0 +1,88 @@
+//
+//          Copyright (c) 2016, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#ifndef DIFFCACHE_H
+#define DIFFCACHE_H
+
+#include "git/Commit.h"
+#include "git/Diff.h"
+#include "git/Id.h"
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QPair>
+
+// Compute commit diffs with rename detection on worker threads. Recent
+// diffs are kept in a small LRU keyed by old tree, new tree and options.
+class DiffCache : public QObject
+{
+  Q_OBJECT
+
+public:
+  // A commit and the base to diff against. An invalid
+  // base diffs against the commit's first parent.
+  typedef QPair<git::Commit,git::Commit> Request;
+
+  DiffCache(QObject *parent = nullptr);
+  ~DiffCache() override;
+
+  // Get the diff if it's already computed.
+  git::Diff cachedDiff(
+    const git::Commit &commit,
+    const git::Commit &base = git::Commit());
+
+  // Get the diff, waiting for a pending request
+  // or computing it on this thread if necessary.
+  git::Diff diff(
+    const git::Commit &commit,
+    const git::Commit &base = git::Commit());
+
+  // Check if the diff is still being computed.
+  bool isPending(
+    const git::Commit &commit,
+    const git::Commit &base = git::Commit()) const;
+
+  // Compute diffs in the background. Pending
+  // requests that aren't in the list are canceled.
+  void fetch(const QList<Request> &requests);
+
+signals:
+  void diffReady();
+
+private:
+  struct Key
+  {
+    git::Id oldTree;
+    git::Id newTree;
+    bool ignoreWhitespace;
+
+    bool operator==(const Key &rhs) const
+    {
+      return (oldTree == rhs.oldTree && newTree == rhs.newTree &&
+              ignoreWhitespace == rhs.ignoreWhitespace);
+    }
+  };
+
+  class Job;
+
+  Key key(const git::Commit &commit, const git::Commit &base) const;
+
+  void insert(const Key &key, const git::Diff &diff);
+  void finish(const Key &key, Job *job);
+
+  QList<Key> mKeys; // most recent first
+  QHash<Key,git::Diff> mDiffs;
+
+  QHash<Key,Job *> mJobs;
+  QList<Job *> mCanceledJobs;
+
+  friend uint qHash(const Key &key);
+};
+
+#endif
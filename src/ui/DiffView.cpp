@@ -14,6 +14,7 @@
 #include "FileContextMenu.h"
 #include "MenuBar.h"
 #include "RepoView.h"
+#include "WordDiff.h"
 #include "app/Application.h"
 #include "conf/Settings.h"
 #include "git/Blame.h"
@@ -56,6 +57,7 @@
 #include <QTextStream>
 #include <QToolButton>
 #include <QVBoxLayout>
+#include <QtConcurrent>
 #include <QtMath>
 
 namespace {
@@ -65,6 +67,17 @@ const int kArrowWidth = 20;
 const int kArrowMargin = 6;
 const QString kHunkFmt = "<h4>%1</h4>";
 
+// Editors are attached to hunks within a page of the viewport and
+// released from hunks more than three pages away. A few released
+// editors are kept for reuse.
+const int kAttachPages = 1;
+const int kReleasePages = 3;
+const int kEditorPoolSize = 16;
+
+// Patches are generated on worker threads up
+// to this many files ahead of the loaded files.
+const int kPatchQueueSize = 16;
+
 const QString kStyleSheet =
   "DiffView {"
   "  border-image: url(:/sunken.png) 4 4 4 4;"
@@ -787,7 +800,8 @@ public:
     bool lfs,
     bool submodule,
     QWidget *parent = nullptr)
-    : QFrame(parent), mView(view), mPatch(patch), mIndex(index)
+    : QFrame(parent), mView(view), mPatch(patch), mIndex(index),
+      mStatus(diff.isStatusDiff())
   {
     setObjectName("HunkWidget");
     QVBoxLayout *layout = new QVBoxLayout(this);
@@ -797,32 +811,35 @@ public:
     mHeader = new Header(diff, patch, index, lfs, submodule, this);
     layout->addWidget(mHeader);
 
-    mEditor = new Editor(this);
-    mEditor->setLexer(patch.name());
-    mEditor->setCaretStyle(CARETSTYLE_INVISIBLE);
-    mEditor->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    if (index >= 0)
-      mEditor->setLineCount(patch.lineCount(index));
-
-    connect(mEditor, &TextEditor::updateUi,
-            MenuBar::instance(this), &MenuBar::updateCutCopyPaste);
-
-    // Ensure that text margin reacts to settings changes.
-    connect(mEditor, &TextEditor::settingsChanged, [this] {
-      int width = mEditor->textWidth(STYLE_LINENUMBER, mEditor->marginText(0));
-      mEditor->setMarginWidthN(TextEditor::LineNumbers, width);
+    // Reserve the editor height until the view attaches an editor.
+    int lines = (index >= 0) ? patch.lineCount(index) : 1;
+    mPlaceholder = new QWidget(this);
+    mPlaceholder->setFixedHeight(lines * view->lineHeight());
+    layout->addWidget(mPlaceholder);
+
+    connect(mHeader->button(), &DisclosureButton::toggled, [this](bool checked) {
+      if (mEditor) {
+        mEditor->setVisible(checked);
+      } else {
+        mPlaceholder->setVisible(checked);
+      }
     });
 
-    // Darken background when find highlight is active.
-    connect(mEditor, &TextEditor::highlightActivated,
-            this, &HunkWidget::setDisabled);
+    // Apply word diff indicators when they're ready.
+    connect(&mWordDiff, &QFutureWatcher<WordDiff::Ranges>::finished, this,
+    [this] {
+      if (!mEditor || mWordDiff.isCanceled())
+        return;
 
-    // Disable vertical resize.
-    mEditor->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
+      WordDiff::Ranges ranges = mWordDiff.result();
+      mEditor->setIndicatorCurrent(TextEditor::WordDeletion);
+      foreach (const WordDiff::Range &range, ranges.deletions)
+        mEditor->indicatorFillRange(range.pos, range.length);
 
-    layout->addWidget(mEditor);
-    connect(mHeader->button(), &DisclosureButton::toggled,
-            mEditor, &TextEditor::setVisible);
+      mEditor->setIndicatorCurrent(TextEditor::WordAddition);
+      foreach (const WordDiff::Range &range, ranges.additions)
+        mEditor->indicatorFillRange(range.pos, range.length);
+    });
 
     // Handle conflict resolution.
     if (QToolButton *save = mHeader->saveButton()) {
@@ -882,228 +899,141 @@ public:
 
     if (QToolButton *ours = mHeader->oursButton()) {
       connect(ours, &QToolButton::clicked, [this] {
-        mEditor->markerDeleteAll(TextEditor::Theirs);
-        chooseLines(TextEditor::Ours);
+        if (mEditor) {
+          mEditor->markerDeleteAll(TextEditor::Theirs);
+          chooseLines(TextEditor::Ours);
+        }
+
         mPatch.setConflictResolution(mIndex, git::Patch::Ours);
       });
     }
 
     if (QToolButton *theirs = mHeader->theirsButton()) {
       connect(theirs, &QToolButton::clicked, [this] {
-        mEditor->markerDeleteAll(TextEditor::Ours);
-        chooseLines(TextEditor::Theirs);
+        if (mEditor) {
+          mEditor->markerDeleteAll(TextEditor::Ours);
+          chooseLines(TextEditor::Theirs);
+        }
+
         mPatch.setConflictResolution(mIndex, git::Patch::Theirs);
       });
     }
+  }
 
-    // Hook up error margin click.
-    bool status = diff.isStatusDiff();
-    connect(mEditor, &TextEditor::marginClicked, [this, status](int pos) {
-      int line = mEditor->lineFromPosition(pos);
-      QList<TextEditor::Diagnostic> diags = mEditor->diagnostics(line);
-      if (diags.isEmpty())
-        return;
-
-      QTableWidget *table = new QTableWidget(diags.size(), 3);
-      table->setWindowFlag(Qt::Popup);
-      table->setAttribute(Qt::WA_DeleteOnClose);
-      table->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-      table->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-      table->setSizeAdjustPolicy(QAbstractScrollArea::AdjustToContents);
-
-      table->setShowGrid(false);
-      table->setSelectionMode(QAbstractItemView::NoSelection);
-      table->verticalHeader()->setVisible(false);
-      table->horizontalHeader()->setVisible(false);
-
-      QShortcut *esc = new QShortcut(tr("Esc"), table);
-      connect(esc, &QShortcut::activated, table, &QTableWidget::close);
-
-      for (int i = 0; i < diags.size(); ++i) {
-        const TextEditor::Diagnostic &diag = diags.at(i);
-
-        QStyle::StandardPixmap pixmap;
-        switch (diag.kind) {
-          case TextEditor::Note:
-            pixmap = QStyle::SP_MessageBoxInformation;
-            break;
-
-          case TextEditor::Warning:
-            pixmap = QStyle::SP_MessageBoxWarning;
-            break;
-
-          case TextEditor::Error:
-            pixmap = QStyle::SP_MessageBoxCritical;
-            break;
-        }
+  Header *header() const { return mHeader; }
 
-        QIcon icon = style()->standardIcon(pixmap);
-        QTableWidgetItem *item = new QTableWidgetItem(icon, diag.message);
-        item->setToolTip(diag.description);
-        table->setItem(i, 0, item);
-
-        // Add fix button. Disable for deletion lines.
-        QPushButton *fix = new QPushButton(tr("Fix"));
-        bool deletion = (mEditor->markers(line) & (1 << TextEditor::Deletion));
-        fix->setEnabled(status && !deletion && !diag.replacement.isNull());
-        connect(fix, &QPushButton::clicked, [this, line, diag, table] {
-          // Look up the actual line number from the margin.
-          QRegularExpression re("\\s+");
-          QStringList numbers = mEditor->marginText(line).split(re);
-          if (numbers.size() != 2)
-            return;
-
-          int newLine = numbers.last().toInt() - 1;
-          if (newLine < 0)
-            return;
-
-          // Load editor.
-          TextEditor editor;
-          git::Repository repo = mPatch.repo();
-          QString path = repo.workdir().filePath(mPatch.name());
-
-          {
-            // Read file.
-            QFile file(path);
-            if (file.open(QFile::ReadOnly))
-              editor.load(path, repo.decode(file.readAll()));
-          }
+  bool hasEditor() const { return mEditor; }
 
-          if (!editor.length())
-            return;
+  TextEditor *editor(bool ensureLoaded = true) {
+    acquireEditor();
+    if (ensureLoaded)
+      load();
+    return mEditor;
+  }
 
-          // Replace range.
-          int pos = editor.positionFromLine(newLine) + diag.range.pos;
-          editor.setSelection(pos + diag.range.len, pos);
-          editor.replaceSelection(diag.replacement);
+  // Take an editor from the view's pool in place of the placeholder.
+  void acquireEditor()
+  {
+    if (mEditor)
+      return;
 
-          // Write file to disk.
-          QSaveFile file(path);
-          if (!file.open(QFile::WriteOnly))
-            return;
+    mEditor = mView->acquireEditor();
+    mEditor->setLexer(mPatch.name());
+    if (mIndex >= 0)
+      mEditor->setLineCount(mPatch.lineCount(mIndex));
 
-          QTextStream out(&file);
-          out.setCodec(repo.codec());
-          out << editor.text();
-          file.commit();
+    // Ensure that text margin reacts to settings changes.
+    connect(mEditor, &TextEditor::settingsChanged, this, [this] {
+      int width = mEditor->textWidth(STYLE_LINENUMBER, mEditor->marginText(0));
+      mEditor->setMarginWidthN(TextEditor::LineNumbers, width);
+    });
 
-          table->hide();
-          RepoView::parentView(this)->refresh();
-        });
+    // Darken background when find highlight is active.
+    connect(mEditor, &TextEditor::highlightActivated,
+            this, &HunkWidget::setDisabled);
 
-        table->setCellWidget(i, 1, fix);
-
-        // Add edit button.
-        QPushButton *edit = new QPushButton(tr("Edit"));
-        connect(edit, &QPushButton::clicked, [this, line, diag] {
-          // Look up the actual line number from the margin.
-          QRegularExpression re("\\s+");
-          QStringList numbers = mEditor->marginText(line).split(re);
-          if (numbers.size() != 2)
-            return;
-
-          int newLine = numbers.last().toInt() - 1;
-          if (newLine < 0)
-            return;
-
-          // Edit the file and select the range.
-          RepoView *view = RepoView::parentView(this);
-          EditorWindow *window = view->openEditor(mPatch.name(), newLine);
-          TextEditor *editor = window->widget()->editor();
-          int pos = editor->positionFromLine(newLine) + diag.range.pos;
-          editor->setSelection(pos + diag.range.len, pos);
-        });
+    // Hook up error margin click.
+    connect(mEditor, &TextEditor::marginClicked,
+            this, &HunkWidget::showDiagnostics);
 
-        table->setCellWidget(i, 2, edit);
-      }
+    // Forward diagnostics added by plugins.
+    connect(mEditor, &TextEditor::diagnosticAdded,
+            this, &HunkWidget::diagnosticAdded);
 
-      table->resizeColumnsToContents();
-      table->resize(table->sizeHint());
+    QVBoxLayout *layout = static_cast<QVBoxLayout *>(this->layout());
+    delete layout->replaceWidget(mPlaceholder, mEditor);
+    mEditor->setVisible(mHeader->button()->isChecked());
+    mPlaceholder->hide();
 
-      QPoint point = mEditor->pointFromPosition(pos);
-      point.setY(point.y() + mEditor->textHeight(line));
-      table->move(mEditor->mapToGlobal(point));
-      table->show();
-    });
+    mLoaded = false;
+    update();
   }
 
-  Header *header() const { return mHeader; }
+  // Return the editor to the view's pool and restore the placeholder.
+  void releaseEditor()
+  {
+    if (!mEditor)
+      return;
 
-  TextEditor *editor(bool ensureLoaded = true) {
-    if (ensureLoaded)
-      load();
-    return mEditor;
+    // Remember the loaded height.
+    if (mLoaded)
+      mPlaceholder->setFixedHeight(mEditor->height());
+
+    cancelWordDiff();
+    mEditor->disconnect(this);
+    mEditor->reset();
+
+    QVBoxLayout *layout = static_cast<QVBoxLayout *>(this->layout());
+    delete layout->replaceWidget(mEditor, mPlaceholder);
+    mPlaceholder->setVisible(mHeader->button()->isChecked());
+
+    mView->releaseEditor(mEditor);
+    mEditor = nullptr;
+    mLoaded = false;
+    setDisabled(false);
   }
 
   void invalidate()
   {
-    mEditor->setReadOnly(false);
-    mEditor->clearAll();
+    cancelWordDiff();
+    if (mEditor) {
+      mEditor->setReadOnly(false);
+      mEditor->clearAll();
+    }
+
     mLoaded = false;
     update();
   }
 
+signals:
+  void diagnosticAdded(int line, const TextEditor::Diagnostic &diag);
+
 protected:
   void paintEvent(QPaintEvent *event) override
   {
-    load();
-    QFrame::paintEvent(event);
-  }
-
-private:
-  struct Token
-  {
-    int pos;
-    QByteArray text;
-  };
-
-  int tokenEndPosition(int pos) const
-  {
-    int length = mEditor->length();
-    char ch = mEditor->charAt(pos);
-    QByteArray wordChars = mEditor->wordChars();
-    if (wordChars.contains(ch)) {
-      do {
-        ch = mEditor->charAt(++pos);
-      } while (pos < length && wordChars.contains(ch));
-      return pos;
-    }
-
-    QByteArray spaceChars = mEditor->whitespaceChars();
-    if (spaceChars.contains(ch)) {
-      do {
-        ch = mEditor->charAt(++pos);
-      } while (pos < length && spaceChars.contains(ch));
-      return pos;
+    // Editors are normally attached by the view before they're
+    // painted. Don't change the layout from inside a paint event.
+    if (mEditor) {
+      load();
+    } else {
+      QTimer::singleShot(0, this, [this] { acquireEditor(); });
     }
 
-    return pos + 1;
+    QFrame::paintEvent(event);
   }
 
-  QList<Token> tokens(int line) const
+private:
+  WordDiff::Line wordDiffLine(int line) const
   {
-    QList<Token> tokens;
-
-    int end = mEditor->lineEndPosition(line);
     int pos = mEditor->positionFromLine(line);
-    while (pos < end) {
-      int wordEnd = tokenEndPosition(pos);
-      tokens.append({pos, mEditor->textRange(pos, wordEnd)});
-      pos = wordEnd;
-    }
-
-    // Add sentinel.
-    tokens.append({pos, ""});
-
-    return tokens;
+    int end = mEditor->lineEndPosition(line);
+    return {pos, mEditor->textRange(pos, end)};
   }
 
-  QByteArray tokenBuffer(const QList<Token> &tokens)
+  // Discard the pending word diff. Its positions are stale.
+  void cancelWordDiff()
   {
-    QByteArrayList list;
-    foreach (const Token &token, tokens)
-      list.append(token.text);
-    return list.join('\n');
+    mWordDiff.setFuture(QFuture<WordDiff::Ranges>());
   }
 
   void load()
@@ -1313,53 +1243,19 @@ private:
         mEditor->markerAdd(lidx, marker);
     }
 
-    // Diff matching lines.
+    // Diff matching lines word by word on a worker.
+    WordDiff words(mEditor->wordChars(), mEditor->whitespaceChars());
     for (int lidx = 0; lidx < count; ++lidx) {
       const Line &line = lines.at(lidx);
       int matchingLine = line.matchingLine();
-      if (line.origin() == GIT_DIFF_LINE_DELETION && matchingLine >= 0) {
-        // Split lines into tokens and diff corresponding tokens.
-        QList<Token> oldTokens = tokens(lidx);
-        QList<Token> newTokens = tokens(matchingLine);
-        QByteArray oldBuffer = tokenBuffer(oldTokens);
-        QByteArray newBuffer = tokenBuffer(newTokens);
-        git::Patch patch = git::Patch::fromBuffers(oldBuffer, newBuffer);
-        for (int pidx = 0; pidx < patch.count(); ++pidx) {
-          // Find the boundary between additions and deletions.
-          int index;
-          int count = patch.lineCount(pidx);
-          for (index = 0; index < count; ++index) {
-            if (patch.lineOrigin(pidx, index) == GIT_DIFF_LINE_ADDITION)
-              break;
-          }
-
-          // Map differences onto the deletion line.
-          if (index > 0) {
-            int first = patch.lineNumber(pidx, 0, git::Diff::OldFile) - 1;
-            int last = patch.lineNumber(pidx, index - 1, git::Diff::OldFile);
-
-            int size = oldTokens.size();
-            if (first >= 0 && first < size && last >= 0 && last < size) {
-              int pos = oldTokens.at(first).pos;
-              mEditor->setIndicatorCurrent(TextEditor::WordDeletion);
-              mEditor->indicatorFillRange(pos, oldTokens.at(last).pos - pos);
-            }
-          }
-
-          // Map differences onto the addition line.
-          if (index < count) {
-            int first = patch.lineNumber(pidx, index, git::Diff::NewFile) - 1;
-            int last = patch.lineNumber(pidx, count - 1, git::Diff::NewFile);
+      if (line.origin() == GIT_DIFF_LINE_DELETION && matchingLine >= 0)
+        words.addLines(wordDiffLine(lidx), wordDiffLine(matchingLine));
+    }
 
-            int size = newTokens.size();
-            if (first >= 0 && first < size && last >= 0 && last < size) {
-              int pos = newTokens.at(first).pos;
-              mEditor->setIndicatorCurrent(TextEditor::WordAddition);
-              mEditor->indicatorFillRange(pos, newTokens.at(last).pos - pos);
-            }
-          }
-        }
-      }
+    if (!words.isEmpty()) {
+      mWordDiff.setFuture(QtConcurrent::run([words] {
+        return words.ranges();
+      }));
     }
 
     // Set margin width.
@@ -1371,15 +1267,18 @@ private:
     // Disallow editing.
     mEditor->setReadOnly(true);
 
-    // Restore resolved conflicts.
+    // Restore resolved conflicts. The buttons are disabled once a side
+    // is chosen, and the side may have been chosen without an editor.
     if (mPatch.isConflicted()) {
       switch (mPatch.conflictResolution(mIndex)) {
         case git::Patch::Ours:
-          mHeader->oursButton()->click();
+          mEditor->markerDeleteAll(TextEditor::Theirs);
+          chooseLines(TextEditor::Ours);
           break;
 
         case git::Patch::Theirs:
-          mHeader->theirsButton()->click();
+          mEditor->markerDeleteAll(TextEditor::Ours);
+          chooseLines(TextEditor::Theirs);
           break;
 
         default:
@@ -1396,8 +1295,139 @@ private:
     mEditor->updateGeometry();
   }
 
+  void showDiagnostics(int pos)
+  {
+    int line = mEditor->lineFromPosition(pos);
+    QList<TextEditor::Diagnostic> diags = mEditor->diagnostics(line);
+    if (diags.isEmpty())
+      return;
+
+    QTableWidget *table = new QTableWidget(diags.size(), 3);
+    table->setWindowFlag(Qt::Popup);
+    table->setAttribute(Qt::WA_DeleteOnClose);
+    table->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    table->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    table->setSizeAdjustPolicy(QAbstractScrollArea::AdjustToContents);
+
+    table->setShowGrid(false);
+    table->setSelectionMode(QAbstractItemView::NoSelection);
+    table->verticalHeader()->setVisible(false);
+    table->horizontalHeader()->setVisible(false);
+
+    QShortcut *esc = new QShortcut(tr("Esc"), table);
+    connect(esc, &QShortcut::activated, table, &QTableWidget::close);
+
+    for (int i = 0; i < diags.size(); ++i) {
+      const TextEditor::Diagnostic &diag = diags.at(i);
+
+      QStyle::StandardPixmap pixmap;
+      switch (diag.kind) {
+        case TextEditor::Note:
+          pixmap = QStyle::SP_MessageBoxInformation;
+          break;
+
+        case TextEditor::Warning:
+          pixmap = QStyle::SP_MessageBoxWarning;
+          break;
+
+        case TextEditor::Error:
+          pixmap = QStyle::SP_MessageBoxCritical;
+          break;
+      }
+
+      QIcon icon = style()->standardIcon(pixmap);
+      QTableWidgetItem *item = new QTableWidgetItem(icon, diag.message);
+      item->setToolTip(diag.description);
+      table->setItem(i, 0, item);
+
+      // Add fix button. Disable for deletion lines.
+      QPushButton *fix = new QPushButton(tr("Fix"));
+      bool deletion = (mEditor->markers(line) & (1 << TextEditor::Deletion));
+      fix->setEnabled(mStatus && !deletion && !diag.replacement.isNull());
+      connect(fix, &QPushButton::clicked, [this, line, diag, table] {
+        // Look up the actual line number from the margin.
+        QRegularExpression re("\\s+");
+        QStringList numbers = mEditor->marginText(line).split(re);
+        if (numbers.size() != 2)
+          return;
+
+        int newLine = numbers.last().toInt() - 1;
+        if (newLine < 0)
+          return;
+
+        // Load editor.
+        TextEditor editor;
+        git::Repository repo = mPatch.repo();
+        QString path = repo.workdir().filePath(mPatch.name());
+
+        {
+          // Read file.
+          QFile file(path);
+          if (file.open(QFile::ReadOnly))
+            editor.load(path, repo.decode(file.readAll()));
+        }
+
+        if (!editor.length())
+          return;
+
+        // Replace range.
+        int pos = editor.positionFromLine(newLine) + diag.range.pos;
+        editor.setSelection(pos + diag.range.len, pos);
+        editor.replaceSelection(diag.replacement);
+
+        // Write file to disk.
+        QSaveFile file(path);
+        if (!file.open(QFile::WriteOnly))
+          return;
+
+        QTextStream out(&file);
+        out.setCodec(repo.codec());
+        out << editor.text();
+        file.commit();
+
+        table->hide();
+        RepoView::parentView(this)->refresh();
+      });
+
+      table->setCellWidget(i, 1, fix);
+
+      // Add edit button.
+      QPushButton *edit = new QPushButton(tr("Edit"));
+      connect(edit, &QPushButton::clicked, [this, line, diag] {
+        // Look up the actual line number from the margin.
+        QRegularExpression re("\\s+");
+        QStringList numbers = mEditor->marginText(line).split(re);
+        if (numbers.size() != 2)
+          return;
+
+        int newLine = numbers.last().toInt() - 1;
+        if (newLine < 0)
+          return;
+
+        // Edit the file and select the range.
+        RepoView *view = RepoView::parentView(this);
+        EditorWindow *window = view->openEditor(mPatch.name(), newLine);
+        TextEditor *editor = window->widget()->editor();
+        int pos = editor->positionFromLine(newLine) + diag.range.pos;
+        editor->setSelection(pos + diag.range.len, pos);
+      });
+
+      table->setCellWidget(i, 2, edit);
+    }
+
+    table->resizeColumnsToContents();
+    table->resize(table->sizeHint());
+
+    QPoint point = mEditor->pointFromPosition(pos);
+    point.setY(point.y() + mEditor->textHeight(line));
+    table->move(mEditor->mapToGlobal(point));
+    table->show();
+  }
+
   void chooseLines(TextEditor::Marker kind)
   {
+    cancelWordDiff();
+
     // Edit hunk.
     mEditor->setReadOnly(false);
     int mask = ((1 << TextEditor::Context) | (1 << kind));
@@ -1415,10 +1445,14 @@ private:
   DiffView *mView;
   git::Patch mPatch;
   int mIndex;
+  bool mStatus;
 
   Header *mHeader;
-  TextEditor *mEditor;
+  QWidget *mPlaceholder;
+  TextEditor *mEditor = nullptr;
   bool mLoaded = false;
+
+  QFutureWatcher<WordDiff::Ranges> mWordDiff;
 };
 
 class LineStats : public QWidget
@@ -1975,7 +2009,7 @@ public:
     connect(check, &QCheckBox::clicked, this, &FileWidget::stageHunks);
 
     // Respond to editor diagnostic signal.
-    connect(hunk->editor(false), &TextEditor::diagnosticAdded,
+    connect(hunk, &HunkWidget::diagnosticAdded,
     [this](int line, const TextEditor::Diagnostic &diag) {
       emit diagnosticAdded(diag.kind);
     });
@@ -2038,6 +2072,9 @@ DiffView::DiffView(const git::Repository &repo, QWidget *parent)
 
   mPlugins = Plugin::plugins(repo);
 
+  // Patches are generated one at a time. They lock the diff anyway.
+  mPatchPool.setMaxThreadCount(1);
+
   // Update comments.
   if (Repository *remote = RepoView::parentView(this)->remoteRepo()) {
     connect(remote->account(), &Account::commentsReady, this, [this, remote](
@@ -2068,7 +2105,13 @@ DiffView::DiffView(const git::Repository &repo, QWidget *parent)
   }
 }
 
-DiffView::~DiffView() {}
+DiffView::~DiffView()
+{
+  // Wait for workers that are still using the repository.
+  cancelPatches();
+  foreach (QFuture<git::Patch> future, mCanceledPatches)
+    future.waitForFinished();
+}
 
 QWidget *DiffView::file(int index)
 {
@@ -2086,8 +2129,17 @@ void DiffView::setDiff(const git::Diff &diff)
     disconnect(connection);
   mConnections.clear();
 
+  // Recycle editors.
+  foreach (QWidget *widget, mFiles) {
+    foreach (HunkWidget *hunk, static_cast<FileWidget *>(widget)->hunks())
+      hunk->releaseEditor();
+  }
+
   // Clear state.
+  cancelPatches();
   mFiles.clear();
+  mLineHeight = -1;
+  mEditorsPinned = false;
   mStagedPatches.clear();
   mComments = Account::CommitComments();
 
@@ -2152,6 +2204,7 @@ void DiffView::setDiff(const git::Diff &diff)
     }
   }
 
+  fetchPatches();
   if (canFetchMore())
     fetchMore();
 
@@ -2161,6 +2214,7 @@ void DiffView::setDiff(const git::Diff &diff)
     connect(scrollBar, &QScrollBar::valueChanged, [this](int value) {
       if (value > verticalScrollBar()->maximum() / 2 && canFetchMore())
         fetchMore();
+      updateEditors();
     })
   );
 
@@ -2168,6 +2222,7 @@ void DiffView::setDiff(const git::Diff &diff)
     connect(scrollBar, &QScrollBar::rangeChanged, [this](int min, int max) {
       if (max - min < this->widget()->height() / 2 && canFetchMore())
         fetchMore();
+      updateEditors();
     })
   );
 
@@ -2210,7 +2265,10 @@ void DiffView::setFilter(const QStringList &paths)
 
 QList<TextEditor *> DiffView::editors()
 {
+  // Find keeps editor pointers and highlights.
+  // Don't recycle editors until the diff changes.
   fetchAll();
+  mEditorsPinned = true;
   QList<TextEditor *> editors;
   foreach (QWidget *widget, mFiles) {
     foreach (HunkWidget *hunk, static_cast<FileWidget *>(widget)->hunks())
@@ -2241,6 +2299,48 @@ void DiffView::ensureVisible(TextEditor *editor, int pos)
   }
 }
 
+int DiffView::lineHeight()
+{
+  if (mLineHeight < 0) {
+    TextEditor *editor = acquireEditor();
+    mLineHeight = editor->textHeight(0);
+    releaseEditor(editor);
+  }
+
+  return mLineHeight;
+}
+
+TextEditor *DiffView::acquireEditor()
+{
+  if (!mEditorPool.isEmpty())
+    return mEditorPool.takeLast();
+
+  TextEditor *editor = new Editor(this);
+  editor->hide();
+  editor->setCaretStyle(CARETSTYLE_INVISIBLE);
+  editor->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+
+  // Disable vertical resize.
+  editor->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
+
+  connect(editor, &TextEditor::updateUi,
+          MenuBar::instance(this), &MenuBar::updateCutCopyPaste);
+
+  return editor;
+}
+
+void DiffView::releaseEditor(TextEditor *editor)
+{
+  if (mEditorPool.size() >= kEditorPoolSize) {
+    editor->deleteLater();
+    return;
+  }
+
+  editor->hide();
+  editor->setParent(this);
+  mEditorPool.append(editor);
+}
+
 void DiffView::dropEvent(QDropEvent *event)
 {
   if (event->dropAction() != Qt::CopyAction)
@@ -2280,7 +2380,7 @@ void DiffView::fetchMore()
   int patchCount = mDiff.count();
   RepoView *view = RepoView::parentView(this);
   for (int pidx = init; pidx < patchCount && pidx - init < 8; ++pidx) {
-    git::Patch patch = mDiff.patch(pidx);
+    git::Patch patch = this->patch(pidx);
     if (!patch.isValid()) {
       // This diff is stale. Refresh the view.
       QTimer::singleShot(0, view, &RepoView::refresh);
@@ -2304,6 +2404,9 @@ void DiffView::fetchMore()
             this, &DiffView::diagnosticAdded);
   }
 
+  // Queue patches for the next batch.
+  fetchPatches();
+
   // Finish layout.
   if (mFiles.size() == mDiff.count()) {
     // Add comments widget.
@@ -2314,6 +2417,81 @@ void DiffView::fetchMore()
   }
 }
 
+void DiffView::fetchPatches()
+{
+  if (!mDiff.isValid())
+    return;
+
+  git::Diff diff = mDiff;
+  QAtomicInt *current = &mPatchGeneration;
+  int generation = current->loadAcquire();
+  int init = mFiles.size();
+  int end = qMin(init + kPatchQueueSize, mDiff.count());
+  for (int pidx = init; pidx < end; ++pidx) {
+    if (mPatches.contains(pidx))
+      continue;
+
+    mPatches.insert(pidx, QtConcurrent::run(&mPatchPool,
+    [diff, pidx, current, generation] {
+      // Skip patches for a diff that's no longer shown.
+      if (current->loadAcquire() != generation)
+        return git::Patch();
+
+      return diff.patch(pidx);
+    }));
+  }
+}
+
+void DiffView::cancelPatches()
+{
+  mPatchGeneration.fetchAndAddOrdered(1);
+
+  // Keep unfinished jobs until they're done.
+  QList<QFuture<git::Patch>> futures = mCanceledPatches + mPatches.values();
+  mCanceledPatches.clear();
+  foreach (const QFuture<git::Patch> &future, futures) {
+    if (!future.isFinished())
+      mCanceledPatches.append(future);
+  }
+
+  mPatches.clear();
+}
+
+git::Patch DiffView::patch(int index)
+{
+  // Wait for the queued patch. A job that
+  // hasn't started yet runs on this thread.
+  if (mPatches.contains(index))
+    return mPatches.take(index).result();
+
+  return mDiff.patch(index);
+}
+
+void DiffView::updateEditors()
+{
+  QWidget *widget = this->widget();
+  int height = viewport()->height();
+  QRect view(0, verticalScrollBar()->value(), widget->width(), height);
+  QRect attach = view.adjusted(0, -kAttachPages * height,
+                               0, kAttachPages * height);
+  QRect keep = view.adjusted(0, -kReleasePages * height,
+                             0, kReleasePages * height);
+
+  foreach (QWidget *file, mFiles) {
+    foreach (HunkWidget *hunk, static_cast<FileWidget *>(file)->hunks()) {
+      QRect rect(hunk->mapTo(widget, QPoint()), hunk->size());
+      bool visible = hunk->isVisibleTo(widget);
+      if (visible && rect.intersects(attach)) {
+        hunk->acquireEditor();
+      } else if (!mEditorsPinned && hunk->hasEditor() &&
+                 (!visible || !rect.intersects(keep)) &&
+                 !hunk->editor(false)->hasFocus()) {
+        hunk->releaseEditor();
+      }
+    }
+  }
+}
+
 void DiffView::fetchAll(int index)
 {
   // Load all patches up to and including index.
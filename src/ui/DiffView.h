@@ -17,8 +17,11 @@
 #include "git/Index.h"
 #include "host/Account.h"
 #include "plugins/Plugin.h"
+#include <QAtomicInt>
+#include <QFuture>
 #include <QMap>
 #include <QScrollArea>
+#include <QThreadPool>
 
 class QCheckBox;
 class QVBoxLayout;
@@ -35,6 +38,9 @@ public:
 
   void setDiff(const git::Diff &diff);
 
+  // Stop generating patches before the diff is modified.
+  void cancelPatches();
+
   bool scrollToFile(int index);
   void setFilter(const QStringList &paths);
 
@@ -44,6 +50,12 @@ public:
   QList<TextEditor *> editors() override;
   void ensureVisible(TextEditor *editor, int pos) override;
 
+  // Hunk editors are created on demand and recycled. Hunks without
+  // an editor reserve space for their lines at the editor line height.
+  int lineHeight();
+  TextEditor *acquireEditor();
+  void releaseEditor(TextEditor *editor);
+
 signals:
   void diagnosticAdded(TextEditor::DiagnosticKind kind);
 
@@ -56,12 +68,28 @@ private:
   void fetchMore();
   void fetchAll(int index = -1);
 
+  // Generate patches ahead of the loaded files on a worker thread.
+  void fetchPatches();
+  git::Patch patch(int index);
+
+  // Attach editors near the viewport and release distant ones.
+  void updateEditors();
+
   git::Diff mDiff;
   QMap<QString,git::Patch> mStagedPatches;
 
   QList<QWidget *> mFiles;
   QList<QMetaObject::Connection> mConnections;
 
+  QMap<int,QFuture<git::Patch>> mPatches;
+  QList<QFuture<git::Patch>> mCanceledPatches;
+  QAtomicInt mPatchGeneration;
+  QThreadPool mPatchPool;
+
+  QList<TextEditor *> mEditorPool;
+  bool mEditorsPinned = false;
+  int mLineHeight = -1;
+
   QList<PluginRef> mPlugins;
   Account::CommitComments mComments;
 };
@@ -90,6 +90,8 @@ void DiffWidget::setDiff(
   const QString &file,
   const QString &pathspec)
 {
+  // Sorting reorders the diff that patches are generated from.
+  mDiffView->cancelPatches();
   mDiff = diff;
 
   // Cancel find.
@@ -40,11 +40,15 @@
 #include "host/Accounts.h"
 #include "index/Index.h"
 #include "log/LogEntry.h"
+#include "log/LogModel.h"
 #include "log/LogView.h"
 #include "watcher/RepositoryWatcher.h"
+#include <QAtomicInt>
 #include <QCheckBox>
 #include <QCloseEvent>
 #include <QDesktopServices>
+#include <QElapsedTimer>
+#include <QLocale>
 #include <QMessageBox>
 #include <QtNetwork>
 #include <QPushButton>
@@ -126,6 +130,117 @@ private:
   QList<LogEntry *> mEntries;
 };
 
+// Hash an untracked directory or a large file in the background.
+class BackgroundStager : public QObject, public git::Index::Callbacks
+{
+  Q_OBJECT
+
+public:
+  BackgroundStager(
+    const git::Index &index,
+    const QString &path,
+    bool dir,
+    LogEntry *log,
+    QObject *parent = nullptr)
+    : QObject(parent), mIndex(index), mPath(path), mDir(dir), mLog(log)
+  {
+    // Connect with automatic type.
+    connect(this, &BackgroundStager::queueProgress,
+            this, &BackgroundStager::progressImpl);
+    connect(&mWatcher, &QFutureWatcher<bool>::finished,
+            this, &BackgroundStager::finish);
+
+    mLog->setBusy(true);
+    mWatcher.setFuture(QtConcurrent::run([this] {
+      if (mDir)
+        return mIndex.hashDirectory(mPath, mFiles, this);
+
+      mFiles.resize(1);
+      return mIndex.hashFile(mPath, mFiles[0], this);
+    }));
+  }
+
+  ~BackgroundStager()
+  {
+    cancel();
+    mWatcher.waitForFinished();
+  }
+
+  LogEntry *log() const
+  {
+    return mLog;
+  }
+
+  void cancel()
+  {
+    mCanceled.storeRelease(1);
+  }
+
+  bool progress(const QString &path, int current, int total) override
+  {
+    // Throttle updates during the walk.
+    if (total > 0 || !mTimer.isValid() || mTimer.elapsed() > 100) {
+      mTimer.start();
+      emit queueProgress(current, total);
+    }
+
+    return !mCanceled.loadAcquire();
+  }
+
+signals:
+  void queueProgress(int current, int total);
+
+private:
+  void progressImpl(int current, int total)
+  {
+    QString text = tr("Finding files: %1").arg(current);
+    if (total > 0) {
+      int percent = 100 * (static_cast<float>(current) / total);
+      if (mDir) {
+        text = tr("Hashing files: %1% (%2/%3)").arg(percent);
+        text = text.arg(current).arg(total);
+      } else {
+        // Sizes are in KiB.
+        QLocale locale;
+        text = tr("Hashing file: %1% (%2/%3)").arg(percent);
+        text = text.arg(locale.formattedDataSize(qint64(current) * 1024));
+        text = text.arg(locale.formattedDataSize(qint64(total) * 1024));
+      }
+    }
+
+    if (!mProgress) {
+      mProgress = mLog->addEntry(LogEntry::Entry, text);
+    } else {
+      mProgress->setText(text);
+    }
+  }
+
+  void finish()
+  {
+    mLog->setBusy(false);
+    if (mCanceled.loadAcquire() || !mWatcher.result()) {
+      mLog->addEntry(LogEntry::Error, tr("Staging canceled."));
+    } else if (mDir) {
+      mIndex.addDirectory(mPath, mFiles);
+    } else {
+      mIndex.addFile(mFiles[0]);
+    }
+
+    deleteLater();
+  }
+
+  git::Index mIndex;
+  QString mPath;
+  bool mDir;
+  LogEntry *mLog;
+  LogEntry *mProgress = nullptr;
+
+  QElapsedTimer mTimer;
+  QAtomicInt mCanceled;
+  QVector<git::Index::HashedFile> mFiles;
+  QFutureWatcher<bool> mWatcher;
+};
+
 class ScopedCollapse
 {
 public:
@@ -159,6 +274,15 @@ RepoView::RepoView(const git::Repository &repo, MainWindow *parent)
   connect(notifier, &git::RepositoryNotifier::referenceUpdated,
           this, &RepoView::startIndexing);
 
+  // Invalidate revision histories after any reference changes.
+  auto clearRevisions = [this] { mRevisions.clear(); };
+  connect(notifier, &git::RepositoryNotifier::referenceAdded,
+          this, clearRevisions);
+  connect(notifier, &git::RepositoryNotifier::referenceUpdated,
+          this, clearRevisions);
+  connect(notifier, &git::RepositoryNotifier::referenceRemoved,
+          this, clearRevisions);
+
   MenuBar *menuBar = MenuBar::instance(parent);
   connect(this, &RepoView::statusChanged,
           menuBar, &MenuBar::updateStash);
@@ -330,7 +454,7 @@ RepoView::RepoView(const git::Repository &repo, MainWindow *parent)
 
   // large file size warning
   connect(notifier, &git::RepositoryNotifier::largeFileAboutToBeStaged,
-  [this](const QString &file, int size, bool &allow) {
+  [this](const QString &file, qint64 size, bool &allow) {
     if (!Settings::instance()->prompt(Settings::PromptLargeFiles))
       return;
 
@@ -406,6 +530,20 @@ RepoView::RepoView(const git::Repository &repo, MainWindow *parent)
     error(mLogRoot, "stage");
   });
 
+  // Stage whole directories and large files in the background.
+  // Stage into the same index so that its staged state cache is updated.
+  connect(notifier, &git::RepositoryNotifier::directoryStageRequested,
+  [this](const git::Index &index, const QString &dir, bool &handled) {
+    stageInBackground(index, dir, true);
+    handled = true;
+  });
+
+  connect(notifier, &git::RepositoryNotifier::largeFileStageRequested,
+  [this](const git::Index &index, const QString &file, bool &handled) {
+    stageInBackground(index, file, false);
+    handled = true;
+  });
+
   QObject *context = new QObject(this);
   connect(notifier, &git::RepositoryNotifier::lfsNotFound,
   context, [this, context] {
@@ -449,6 +587,10 @@ RepoView::~RepoView()
   // then the focus change may trigger the menu bar to query the mode
   // index from the already destroyed detail view.
   mCommits->clearFocus();
+
+  // Stop staging before the repository is destroyed. The workers
+  // use the raw repository of the index.
+  qDeleteAll(findChildren<BackgroundStager *>());
 }
 
 void RepoView::clean(const QStringList &untracked)
@@ -580,8 +722,28 @@ void RepoView::cancelRemoteTransfer()
     mWatcher->waitForFinished();
 }
 
+void RepoView::stageInBackground(
+  const git::Index &index,
+  const QString &path,
+  bool dir)
+{
+  QString title = dir ? tr("Stage Directory") : tr("Stage File");
+  LogEntry *entry = addLogEntry(path, title);
+  BackgroundStager *stager =
+    new BackgroundStager(index, path, dir, entry, this);
+  connect(mLogView, &LogView::operationCanceled, stager,
+  [stager](const QModelIndex &index) {
+    LogEntry *entry = index.data(LogModel::EntryRole).value<LogEntry *>();
+    if (entry == stager->log())
+      stager->cancel();
+  });
+}
+
 void RepoView::cancelBackgroundTasks()
 {
+  foreach (BackgroundStager *stager, findChildren<BackgroundStager *>())
+    stager->cancel();
+
   cancelIndexing();
   cancelRemoteTransfer();
   mCommits->cancelStatus();
@@ -2449,7 +2611,13 @@ git::Commit RepoView::nextRevision(const QString &path) const
   if (commits.isEmpty())
     return git::Commit();
 
+  // Extend the cached history up to the selected commit.
   git::Reference ref = mRefs->currentReference();
+  RevisionHistory &history = revisionHistory(ref, path);
+  int row = history.row(commits.first());
+  if (row >= 0)
+    return (row > 0) ? history.commits.at(row - 1) : git::Commit();
+
   git::RevWalk walker =
     ref.walker(GIT_SORT_TOPOLOGICAL | GIT_SORT_TIME | GIT_SORT_REVERSE);
   walker.hide(commits.first());
@@ -2465,16 +2633,76 @@ git::Commit RepoView::previousRevision(const QString &path) const
     if (!ref.isValid())
       return git::Commit();
 
-    git::RevWalk walker = ref.walker(GIT_SORT_TOPOLOGICAL | GIT_SORT_TIME);
-    return walker.next(path);
+    return revisionHistory(ref, path).commit(0);
   }
 
+  // Step through the cached history one revision at a time.
   git::Commit commit = commits.last();
+  git::Reference ref = mRefs->currentReference();
+  RevisionHistory &history = revisionHistory(ref, path);
+  int row = history.row(commit);
+  if (row >= 0)
+    return history.commit(row + 1);
+
   git::RevWalk walker = commit.walker(GIT_SORT_TOPOLOGICAL | GIT_SORT_TIME);
   walker.next();
   return walker.next(path);
 }
 
+RepoView::RevisionHistory &RepoView::revisionHistory(
+  const git::Reference &ref,
+  const QString &path) const
+{
+  git::Commit target = ref.isValid() ? ref.target() : git::Commit();
+  git::Id id = target.isValid() ? target.id() : git::Id();
+
+  RevisionHistory &history = mRevisions[path];
+  if (history.target.isValid() && history.target == id)
+    return history;
+
+  // Start a new walk. It's advanced on demand.
+  history = RevisionHistory();
+  history.target = id;
+  history.path = path;
+  if (target.isValid())
+    history.walker = ref.walker(GIT_SORT_TOPOLOGICAL | GIT_SORT_TIME);
+
+  return history;
+}
+
+git::Commit RepoView::RevisionHistory::commit(int row)
+{
+  while (commits.size() <= row && walker.isValid()) {
+    git::Commit commit = walker.next(path);
+    if (!commit.isValid()) {
+      walker = git::RevWalk();
+      break;
+    }
+
+    rows.insert(commit.id(), commits.size());
+    commits.append(commit);
+  }
+
+  return commits.value(row);
+}
+
+int RepoView::RevisionHistory::row(const git::Commit &commit)
+{
+  QDateTime date = commit.committer().date();
+  int row = rows.value(commit.id(), -1);
+  while (row < 0 && walker.isValid()) {
+    // The commit doesn't change the path or isn't on this history.
+    if (!commits.isEmpty() && commits.last().committer().date() < date)
+      break;
+
+    git::Commit next = this->commit(commits.size());
+    if (next == commit)
+      row = commits.size() - 1;
+  }
+
+  return row;
+}
+
 void RepoView::selectCommit(const git::Commit &commit, const QString &file)
 {
   mCommits->selectRange(commit.id().toString(), file, true);
@@ -18,6 +18,7 @@
 #include "git/Reference.h"
 #include "git/Remote.h"
 #include "git/Repository.h"
+#include "git/RevWalk.h"
 #include "git/Submodule.h"
 #include "host/Account.h"
 #include <QFuture>
@@ -120,6 +121,12 @@ public:
   void cancelRemoteTransfer();
   void cancelBackgroundTasks();
 
+  // Stage a directory or a large file on a worker thread.
+  void stageInBackground(
+    const git::Index &index,
+    const QString &path,
+    bool dir);
+
   // links
   void visitLink(const QString &link);
 
@@ -325,11 +332,33 @@ private:
     LogEntry *entry;
   };
 
+  // The commits of the current reference that change a path. The
+  // walk is only advanced as far as stepping through it requires.
+  struct RevisionHistory
+  {
+    // Walk until the row is found or the history ends.
+    git::Commit commit(int row);
+
+    // Walk until the commit is found or the walk passes its date.
+    int row(const git::Commit &commit);
+
+    git::Id target;
+    QString path;
+    git::RevWalk walker;
+    QList<git::Commit> commits;
+    QHash<git::Id,int> rows;
+  };
+
   ToolBar *toolBar() const;
   CommitList *commitList() const;
 
   void notifyReferenceUpdated(const QString &name);
 
+  // Get the cached history of the path.
+  RevisionHistory &revisionHistory(
+    const git::Reference &ref,
+    const QString &path) const;
+
   void startLogTimer();
   bool suspendLogTimer();
   void resumeLogTimer(bool suspended = true);
@@ -354,6 +383,8 @@ private:
 
   History *mHistory;
 
+  mutable QHash<QString,RevisionHistory> mRevisions;
+
   Repository *mRemoteRepo;
   bool mRemoteRepoCached = false;
 
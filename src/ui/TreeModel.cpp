@@ -11,23 +11,74 @@
 #include "conf/Settings.h"
 #include "git/Blob.h"
 #include "git/Diff.h"
-#include "git/RevWalk.h"
 #include "git/Submodule.h"
+#include <QElapsedTimer>
 #include <QStringBuilder>
 #include <QUrl>
+#include <QtConcurrent>
 
 namespace {
 
 const QString kLinkFmt = "<a href='%1'>%2</a>";
 
+// Minimum time between partial history updates.
+const int kHistoryInterval = 200;
+
+// Get the entry ids of the directory without loading blobs.
+QHash<QString,git::Id> entries(const git::Tree &root, const QStringList &dirs)
+{
+  git::Tree tree = root;
+  foreach (const QString &dir, dirs) {
+    int count = tree.count();
+    git::Tree subtree;
+    for (int i = 0; i < count; ++i) {
+      if (tree.name(i) == dir) {
+        subtree = tree.object(i);
+        break;
+      }
+    }
+
+    if (!subtree.isValid())
+      return QHash<QString,git::Id>();
+
+    tree = subtree;
+  }
+
+  QHash<QString,git::Id> result;
+  int count = tree.count();
+  for (int i = 0; i < count; ++i)
+    result.insert(tree.name(i), tree.id(i));
+
+  return result;
+}
+
 } // anon. namespace
 
 TreeModel::TreeModel(const git::Repository &repo, QObject *parent)
   : QAbstractItemModel(parent), mRepo(repo)
-{}
+{
+  connect(this, &TreeModel::historyChanged,
+          this, &TreeModel::updateHistory, Qt::QueuedConnection);
+
+  // New commits can change the results.
+  git::RepositoryNotifier *notifier = repo.notifier();
+  connect(notifier, &git::RepositoryNotifier::referenceAdded,
+          this, &TreeModel::clearHistory);
+  connect(notifier, &git::RepositoryNotifier::referenceUpdated,
+          this, &TreeModel::clearHistory);
+  connect(notifier, &git::RepositoryNotifier::referenceRemoved,
+          this, &TreeModel::clearHistory);
+
+  connect(notifier, &git::RepositoryNotifier::indexChanged,
+          this, &TreeModel::resetStaged);
+}
 
 TreeModel::~TreeModel()
 {
+  mHistoryGeneration.ref();
+  foreach (QFuture<void> walk, mHistoryWalks)
+    walk.waitForFinished();
+
   delete mRoot;
 }
 
@@ -39,6 +90,7 @@ void TreeModel::setTree(const git::Tree &tree, const git::Diff &diff)
   mRoot = tree.isValid() ? new Node(mRepo.workdir().path(), tree) : nullptr;
 
   mDiff = diff;
+  updateStatus();
 
   endResetModel();
 }
@@ -106,36 +158,31 @@ QVariant TreeModel::data(const QModelIndex &index, int role) const
       if (!mDiff.isValid() || !mDiff.isStatusDiff())
         return QVariant();
 
-      QStringList paths;
-      QString prefix = node->path(true);
-      for (int i = 0; i < mDiff.count(); ++i) {
-        QString path = mDiff.name(i);
-        if (path.startsWith(prefix))
-          paths.append(path);
-      }
-
-      if (paths.isEmpty())
+      auto it = mStatus.constFind(node->path(true));
+      if (it == mStatus.constEnd())
         return QVariant();
 
-      int count = 0;
-      git::Index index = mDiff.index();
-      foreach (const QString &path, paths) {
-        switch (index.isStaged(path)) {
-          case git::Index::Disabled:
-          case git::Index::Unstaged:
-          case git::Index::Conflicted:
-            break;
-
-          case git::Index::PartiallyStaged:
-          case git::Index::Staged:
-            ++count;
-            break;
+      if (it->staged < 0) {
+        it->staged = 0;
+        git::Index index = mDiff.index();
+        foreach (const QString &path, it->files) {
+          switch (index.isStaged(path)) {
+            case git::Index::Disabled:
+            case git::Index::Unstaged:
+            case git::Index::Conflicted:
+              break;
+
+            case git::Index::PartiallyStaged:
+            case git::Index::Staged:
+              ++it->staged;
+              break;
+          }
         }
       }
 
-      if (count == 0) {
+      if (it->staged == 0) {
         return Qt::Unchecked;
-      } else if (count == paths.size()) {
+      } else if (it->staged == it->files.size()) {
         return Qt::Checked;
       } else {
         return Qt::PartiallyChecked;
@@ -153,11 +200,28 @@ QVariant TreeModel::data(const QModelIndex &index, int role) const
 
     case AddedRole:
     case ModifiedRole: {
-      int sort = GIT_SORT_TIME;
+      // Look up the entry in the history of its directory.
+      Node *parent = node->parent();
+      QString dir = (parent == mRoot) ? QString() : parent->path(true);
+      HistoryKey key(parent->object().id(), dir);
+
+      QMutexLocker locker(&mHistoryLock);
+      auto it = mHistory.constFind(key);
+      bool running = (mHistoryKey == key && !mHistoryWalks.isEmpty() &&
+                      !mHistoryWalks.last().isFinished());
+      if (it == mHistory.constEnd() || (!it->finished && !running)) {
+        locker.unlock();
+        startHistory(key);
+        return QVariant();
+      }
+
+      Entry entry = it->entries.value(node->name());
+      git::Id id = entry.modified;
       if (role == AddedRole)
-        sort |= GIT_SORT_REVERSE;
-      git::RevWalk walker = mRepo.walker(sort);
-      git::Commit commit = walker.next(node->path(true));
+        id = it->finished ? entry.added : git::Id();
+      locker.unlock();
+
+      git::Commit commit = mRepo.lookupCommit(id);
       if (!commit.isValid())
         return QVariant();
 
@@ -167,22 +231,8 @@ QVariant TreeModel::data(const QModelIndex &index, int role) const
       return kLinkFmt.arg(url.toString(), commit.shortId());
     }
 
-    case StatusRole: {
-      if (!mDiff.isValid())
-        return QString();
-
-      QString status;
-      QString prefix = node->path(true);
-      for (int i = 0; i < mDiff.count(); ++i) {
-        if (mDiff.name(i).startsWith(prefix)) {
-          QChar ch = git::Diff::statusChar(mDiff.status(i));
-          if (!status.contains(ch))
-            status.append(ch);
-        }
-      }
-
-      return status;
-    }
+    case StatusRole:
+      return mStatus.value(node->path(true)).chars;
   }
 
   return QVariant();
@@ -195,15 +245,8 @@ bool TreeModel::setData(
 {
   switch (role) {
     case Qt::CheckStateRole: {
-      QStringList files;
-      Node *node = this->node(index);
-      QString prefix = node->path(true);
-      for (int i = 0; i < mDiff.count(); ++i) {
-        QString file = mDiff.name(i);
-        if (file.startsWith(prefix))
-          files.append(file);
-      }
-
+      QString path = node(index)->path(true);
+      QStringList files = mStatus.value(path).files;
       mDiff.index().setStaged(files, value.toBool());
       emit dataChanged(index, index, {role});
       return true;
@@ -223,6 +266,193 @@ TreeModel::Node *TreeModel::node(const QModelIndex &index) const
   return index.isValid() ? static_cast<Node *>(index.internalPointer()) : mRoot;
 }
 
+void TreeModel::updateStatus()
+{
+  mStatus.clear();
+  if (!mDiff.isValid())
+    return;
+
+  int count = mDiff.count();
+  for (int i = 0; i < count; ++i) {
+    QString file = mDiff.name(i);
+    QChar ch = git::Diff::statusChar(mDiff.status(i));
+
+    // Add the file and each of its leading directories.
+    QString path = file;
+    if (path.endsWith('/'))
+      path.chop(1);
+
+    while (!path.isEmpty()) {
+      Status &status = mStatus[path];
+      status.files.append(file);
+      if (!status.chars.contains(ch))
+        status.chars.append(ch);
+
+      path.truncate(qMax(0, path.lastIndexOf('/')));
+    }
+  }
+}
+
+void TreeModel::resetStaged(const QStringList &paths)
+{
+  foreach (QString path, paths) {
+    if (path.endsWith('/'))
+      path.chop(1);
+
+    while (!path.isEmpty()) {
+      auto it = mStatus.find(path);
+      if (it != mStatus.end())
+        it->staged = -1;
+
+      path.truncate(qMax(0, path.lastIndexOf('/')));
+    }
+  }
+}
+
+void TreeModel::startHistory(const HistoryKey &key) const
+{
+  // Cancel the previous walk.
+  int generation = mHistoryGeneration.fetchAndAddOrdered(1) + 1;
+
+  // Discard finished walks.
+  QList<QFuture<void>>::iterator it = mHistoryWalks.begin();
+  while (it != mHistoryWalks.end())
+    it = it->isFinished() ? mHistoryWalks.erase(it) : it + 1;
+
+  mHistoryKey = key;
+  TreeModel *model = const_cast<TreeModel *>(this);
+  git::RevWalk walker = mRepo.walker(GIT_SORT_TIME);
+  walker.setBuildFilters(true);
+  mHistoryWalks.append(QtConcurrent::run(
+    model, &TreeModel::walkHistory, key, walker, generation));
+}
+
+void TreeModel::walkHistory(
+  const HistoryKey &key,
+  git::RevWalk walker,
+  int generation)
+{
+  // Walk from newest to oldest once for the whole directory. The first
+  // commit that changes an entry modified it and the last one added it.
+  QString dir = key.second;
+  QStringList dirs = dir.split('/', QString::SkipEmptyParts);
+
+  History history;
+  QElapsedTimer timer;
+  timer.start();
+
+  git::Commit commit = walker.next(dir);
+  while (commit.isValid()) {
+    // A newer walk was started.
+    if (mHistoryGeneration.load() != generation)
+      return;
+
+    // The walker only filters merges for non-empty paths.
+    if (!commit.isMerge()) {
+      QHash<QString,git::Id> current = entries(commit.tree(), dirs);
+      QHash<QString,git::Id> previous;
+      QList<git::Commit> parents = commit.parents();
+      if (!parents.isEmpty())
+        previous = entries(parents.first().tree(), dirs);
+
+      QStringList names = current.keys();
+      foreach (const QString &name, previous.keys()) {
+        if (!current.contains(name))
+          names.append(name);
+      }
+
+      foreach (const QString &name, names) {
+        if (current.value(name) == previous.value(name))
+          continue;
+
+        Entry &entry = history.entries[name];
+        if (!entry.modified.isValid())
+          entry.modified = commit.id();
+        entry.added = commit.id();
+      }
+    }
+
+    // Publish partial results periodically.
+    if (timer.elapsed() > kHistoryInterval) {
+      if (!publishHistory(key, history, generation))
+        return;
+      timer.restart();
+    }
+
+    commit = walker.next(dir);
+  }
+
+  history.finished = true;
+  publishHistory(key, history, generation);
+}
+
+bool TreeModel::publishHistory(
+  const HistoryKey &key,
+  const History &history,
+  int generation)
+{
+  // Don't overwrite the results of a newer walk.
+  QMutexLocker locker(&mHistoryLock);
+  if (mHistoryGeneration.load() != generation)
+    return false;
+
+  mHistory[key] = history;
+  locker.unlock();
+
+  emit historyChanged(key.second);
+  return true;
+}
+
+void TreeModel::updateHistory(const QString &dir)
+{
+  if (!mRoot)
+    return;
+
+  // Find the directory node.
+  Node *node = mRoot;
+  foreach (const QString &name, dir.split('/', QString::SkipEmptyParts)) {
+    Node *child = nullptr;
+    foreach (Node *tmp, node->children()) {
+      if (tmp->name() == name) {
+        child = tmp;
+        break;
+      }
+    }
+
+    if (!child)
+      return;
+
+    node = child;
+  }
+
+  int count = node->children().size();
+  if (count == 0)
+    return;
+
+  QModelIndex parent;
+  if (node != mRoot) {
+    Node *grandparent = node->parent();
+    parent = createIndex(grandparent->children().indexOf(node), 0, node);
+  }
+
+  emit dataChanged(index(0, 0, parent), index(count - 1, 0, parent),
+                   {AddedRole, ModifiedRole});
+}
+
+void TreeModel::clearHistory()
+{
+  mHistoryGeneration.ref();
+
+  QMutexLocker locker(&mHistoryLock);
+  mHistory.clear();
+  locker.unlock();
+
+  // Restart the walk if the directory is still shown.
+  QString dir = mHistoryKey.second;
+  mHistoryKey = HistoryKey();
+  updateHistory(dir);
+}
+
 TreeModel::Node::Node(const QString &name, const git::Object &obj, Node *parent)
   : mName(name), mObject(obj), mParent(parent)
 {}
@@ -14,8 +14,13 @@
 #include "git/Index.h"
 #include "git/Tree.h"
 #include "git/Repository.h"
+#include "git/RevWalk.h"
 #include <QAbstractItemModel>
+#include <QAtomicInt>
 #include <QFileIconProvider>
+#include <QFuture>
+#include <QMutex>
+#include <QPair>
 
 class TreeModel : public QAbstractItemModel
 {
@@ -58,7 +63,38 @@ public:
 
   Qt::ItemFlags flags(const QModelIndex &index) const override;
 
+signals:
+  // Emitted from the history walk when new results are available.
+  void historyChanged(const QString &dir);
+
 private:
+  // The commits that added and last modified a tree entry.
+  struct Entry
+  {
+    git::Id added;
+    git::Id modified;
+  };
+
+  // The entries of a directory found so far. Added commits
+  // aren't known until the walk reaches the oldest commit.
+  struct History
+  {
+    QHash<QString,Entry> entries;
+    bool finished = false;
+  };
+
+  // Directory tree id and relative path.
+  typedef QPair<git::Id,QString> HistoryKey;
+
+  // The status diff paths under a file or directory. The staged
+  // count is computed on demand and reset when the index changes.
+  struct Status
+  {
+    QStringList files;
+    QString chars;
+    mutable int staged = -1;
+  };
+
   class Node
   {
   public:
@@ -84,11 +120,35 @@ private:
 
   Node *node(const QModelIndex &index) const;
 
+  // Aggregate the diff by file and leading directories.
+  void updateStatus();
+  void resetStaged(const QStringList &paths);
+
+  // Start walking history for all entries of the directory at once.
+  void startHistory(const HistoryKey &key) const;
+  void walkHistory(const HistoryKey &key, git::RevWalk walker, int generation);
+  bool publishHistory(
+    const HistoryKey &key,
+    const History &history,
+    int generation);
+  void updateHistory(const QString &dir);
+  void clearHistory();
+
   Node *mRoot = nullptr;
   QFileIconProvider mIconProvider;
 
   git::Diff mDiff;
   git::Repository mRepo;
+
+  // Map relative path to aggregated status.
+  QHash<QString,Status> mStatus;
+
+  // Walks are canceled by bumping the generation.
+  mutable QMutex mHistoryLock;
+  mutable QHash<HistoryKey,History> mHistory;
+  mutable QList<QFuture<void>> mHistoryWalks;
+  mutable HistoryKey mHistoryKey;
+  mutable QAtomicInt mHistoryGeneration;
 };
 
 #endif
@@ -0,0 +1,223 @@
+//
+//          Copyright (c) 2016, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#include "WordDiff.h"
+#include <QHash>
+
+namespace {
+
+// Give up on finding the shortest edit script after this
+// many edits and treat the remaining tokens as one change.
+const int kMaxCost = 256;
+
+} // anon. namespace
+
+WordDiff::WordDiff(
+  const QByteArray &wordChars,
+  const QByteArray &whitespaceChars)
+  : mClasses(256, Other)
+{
+  foreach (char ch, wordChars)
+    mClasses[uchar(ch)] = Word;
+  foreach (char ch, whitespaceChars)
+    mClasses[uchar(ch)] = Whitespace;
+}
+
+void WordDiff::addLines(const Line &deletion, const Line &addition)
+{
+  mLines.append({deletion, addition});
+}
+
+WordDiff::Ranges WordDiff::ranges() const
+{
+  Ranges ranges;
+  QHash<QByteArray,int> ids;
+
+  // Map tokens to ids so that they compare as integers.
+  auto map = [&ids](const QByteArray &text, const QVector<int> &tokens) {
+    QVector<int> result;
+    result.reserve(tokens.size() - 1);
+    for (int i = 0; i < tokens.size() - 1; ++i) {
+      int pos = tokens.at(i);
+      int len = tokens.at(i + 1) - pos;
+      const char *data = text.constData() + pos;
+      int id = ids.value(QByteArray::fromRawData(data, len), -1);
+      if (id < 0) {
+        id = ids.size();
+        ids.insert(QByteArray(data, len), id);
+      }
+
+      result.append(id);
+    }
+
+    return result;
+  };
+
+  foreach (const Pair &pair, mLines) {
+    const Line &oldLine = pair.deletion;
+    const Line &newLine = pair.addition;
+    QVector<int> oldTokens = tokenize(oldLine.text);
+    QVector<int> newTokens = tokenize(newLine.text);
+
+    QVector<int> lhs = map(oldLine.text, oldTokens);
+    QVector<int> rhs = map(newLine.text, newTokens);
+    foreach (const Edit &edit, diff(lhs, rhs)) {
+      if (edit.oldBegin < edit.oldEnd) {
+        int pos = oldTokens.at(edit.oldBegin);
+        int length = oldTokens.at(edit.oldEnd) - pos;
+        ranges.deletions.append({oldLine.pos + pos, length});
+      }
+
+      if (edit.newBegin < edit.newEnd) {
+        int pos = newTokens.at(edit.newBegin);
+        int length = newTokens.at(edit.newEnd) - pos;
+        ranges.additions.append({newLine.pos + pos, length});
+      }
+    }
+  }
+
+  return ranges;
+}
+
+QVector<int> WordDiff::tokenize(const QByteArray &text) const
+{
+  QVector<int> tokens;
+  int pos = 0;
+  int length = text.length();
+  while (pos < length) {
+    tokens.append(pos);
+    char kind = mClasses.at(uchar(text.at(pos++)));
+    if (kind == Other)
+      continue;
+
+    while (pos < length && mClasses.at(uchar(text.at(pos))) == kind)
+      ++pos;
+  }
+
+  // Add sentinel.
+  tokens.append(length);
+
+  return tokens;
+}
+
+QList<WordDiff::Edit> WordDiff::diff(
+  const QVector<int> &lhs,
+  const QVector<int> &rhs)
+{
+  // Trim common prefix and suffix.
+  int begin = 0;
+  int oldEnd = lhs.size();
+  int newEnd = rhs.size();
+  while (begin < oldEnd && begin < newEnd && lhs.at(begin) == rhs.at(begin))
+    ++begin;
+  while (oldEnd > begin && newEnd > begin &&
+         lhs.at(oldEnd - 1) == rhs.at(newEnd - 1)) {
+    --oldEnd;
+    --newEnd;
+  }
+
+  int n = oldEnd - begin;
+  int m = newEnd - begin;
+  if (!n && !m)
+    return QList<Edit>();
+
+  if (!n || !m)
+    return {{begin, oldEnd, begin, newEnd}};
+
+  // Find the furthest reaching path on each diagonal k for each
+  // number of edits d. Remember each step to trace the path back.
+  int max = qMin(n + m, kMaxCost);
+  int offset = max + 1;
+  QVector<int> v(2 * offset + 1, 0);
+  QList<QVector<int>> trace;
+
+  bool found = false;
+  for (int d = 0; d <= max && !found; ++d) {
+    trace.append(v);
+    for (int k = -d; k <= d; k += 2) {
+      int x;
+      if (k == -d || (k != d && v.at(offset + k - 1) < v.at(offset + k + 1))) {
+        x = v.at(offset + k + 1); // insertion
+      } else {
+        x = v.at(offset + k - 1) + 1; // deletion
+      }
+
+      int y = x - k;
+      while (x < n && y < m && lhs.at(begin + x) == rhs.at(begin + y)) {
+        ++x;
+        ++y;
+      }
+
+      v[offset + k] = x;
+      if (x >= n && y >= m) {
+        found = true;
+        break;
+      }
+    }
+  }
+
+  if (!found)
+    return {{begin, oldEnd, begin, newEnd}};
+
+  // Walk back through the trace to mark deleted and inserted tokens.
+  QVector<bool> deleted(n, false);
+  QVector<bool> inserted(m, false);
+  int x = n;
+  int y = m;
+  for (int d = trace.size() - 1; d > 0; --d) {
+    const QVector<int> &prev = trace.at(d);
+    int k = x - y;
+    bool down = (k == -d ||
+      (k != d && prev.at(offset + k - 1) < prev.at(offset + k + 1)));
+    int prevK = down ? k + 1 : k - 1;
+
+    int prevX = prev.at(offset + prevK);
+    int prevY = prevX - prevK;
+    while (x > prevX && y > prevY) {
+      --x;
+      --y;
+    }
+
+    if (x == prevX) {
+      inserted[prevY] = true;
+    } else {
+      deleted[prevX] = true;
+    }
+
+    x = prevX;
+    y = prevY;
+  }
+
+  // Group adjacent deletions and insertions between unchanged tokens.
+  QList<Edit> edits;
+  int i = 0;
+  int j = 0;
+  while (i < n || j < m) {
+    if (i < n && j < m && !deleted.at(i) && !inserted.at(j)) {
+      ++i;
+      ++j;
+      continue;
+    }
+
+    int oldBegin = i;
+    int newBegin = j;
+    while (i < n && deleted.at(i))
+      ++i;
+    while (j < m && inserted.at(j))
+      ++j;
+
+    // Guard against an inconsistent script.
+    if (i == oldBegin && j == newBegin)
+      break;
+
+    edits.append({begin + oldBegin, begin + i, begin + newBegin, begin + j});
+  }
+
+  return edits;
+}
@@ -0,0 +1,87 @@
+//
+//          Copyright (c) 2016, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#ifndef WORDDIFF_H
+#define WORDDIFF_H
+
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+
+// Diff pairs of changed lines word by word. Lines are split into runs
+// of word characters, runs of whitespace and single other characters.
+// Tokens are diffed directly with Myers' algorithm. Computing ranges
+// doesn't touch the editor, so it can run on a worker thread.
+class WordDiff
+{
+public:
+  struct Line
+  {
+    int pos; // document position of the line start
+    QByteArray text;
+  };
+
+  struct Range
+  {
+    int pos;
+    int length;
+  };
+
+  struct Ranges
+  {
+    QList<Range> deletions;
+    QList<Range> additions;
+  };
+
+  // A changed region as half-open token index ranges.
+  struct Edit
+  {
+    int oldBegin;
+    int oldEnd;
+    int newBegin;
+    int newEnd;
+  };
+
+  WordDiff(
+    const QByteArray &wordChars = QByteArray(),
+    const QByteArray &whitespaceChars = QByteArray());
+
+  bool isEmpty() const { return mLines.isEmpty(); }
+
+  // Add a deletion line and the addition line that replaced it.
+  void addLines(const Line &deletion, const Line &addition);
+
+  // Get the changed ranges of all added lines.
+  Ranges ranges() const;
+
+  // Get token start offsets followed by the text length.
+  QVector<int> tokenize(const QByteArray &text) const;
+
+  // Get the changed regions between two token sequences.
+  static QList<Edit> diff(const QVector<int> &lhs, const QVector<int> &rhs);
+
+private:
+  struct Pair
+  {
+    Line deletion;
+    Line addition;
+  };
+
+  enum CharClass
+  {
+    Other,
+    Word,
+    Whitespace
+  };
+
+  QVector<char> mClasses;
+  QList<Pair> mLines;
+};
+
+#endif
@@ -8,17 +8,130 @@
 //
 
 #include "RepositoryWatcher.h"
+#include "git/Reference.h"
+#include <QFileInfo>
+
+namespace {
+
+// Files and directories in the git dir that track operation state.
+const QStringList kStateFiles = {
+  "MERGE_HEAD",
+  "MERGE_MSG",
+  "CHERRY_PICK_HEAD",
+  "REVERT_HEAD",
+  "BISECT_LOG",
+  "rebase-merge",
+  "rebase-apply"
+};
+
+} // anon. namespace
 
 void RepositoryWatcher::init(const git::Repository &repo)
 {
+  mRepo = repo;
+
   // The timer has to run on the main thread.
   mTimer.setInterval(2000);
   mTimer.setSingleShot(true);
-  connect(&mTimer, &QTimer::timeout,
-          repo.notifier(), &git::RepositoryNotifier::workdirChanged);
+  connect(&mTimer, &QTimer::timeout, [this] {
+    // Take the pending state first. Handlers may cancel notification.
+    QStringList paths = mPaths.toList();
+    QStringList refs = mRefs.toList();
+    bool packedRefs = mPackedRefs;
+    bool head = mHead;
+    bool index = mIndex;
+    bool state = mState;
+    bool rescan = mRescan;
+    cancelPendingNotification();
+
+    // Checking out a new HEAD resets the status and index anyway.
+    git::RepositoryNotifier *notifier = mRepo.notifier();
+    if (index && !head && !rescan)
+      emit notifier->indexRewritten();
+
+    if (state)
+      emit notifier->stateChanged();
+
+    foreach (const QString &ref, refs) {
+      if (git::Reference reference = mRepo.lookupRef(ref)) {
+        emit notifier->referenceUpdated(reference);
+      } else {
+        packedRefs = true;
+      }
+    }
+
+    // Removed or packed refs can't be identified.
+    if (packedRefs)
+      emit notifier->referenceUpdated(git::Reference());
+
+    if (head)
+      emit notifier->referenceUpdated(mRepo.head());
+
+    if (rescan) {
+      emit notifier->workdirChanged();
+    } else if (!paths.isEmpty()) {
+      emit notifier->workdirChanged(paths);
+    }
+  });
 }
 
 void RepositoryWatcher::cancelPendingNotification()
 {
   mTimer.stop();
+  mPaths.clear();
+  mRefs.clear();
+  mPackedRefs = false;
+  mHead = false;
+  mIndex = false;
+  mState = false;
+  mRescan = false;
+}
+
+void RepositoryWatcher::notify(const QStringList &paths)
+{
+  bool changed = paths.isEmpty();
+  if (changed)
+    mRescan = true;
+
+  QDir dir = mRepo.dir();
+  QDir workdir = mRepo.workdir();
+  QString prefix = dir.path() + '/';
+  foreach (const QString &path, paths) {
+    // Workdir changes are relative to the workdir.
+    if (path != dir.path() && !path.startsWith(prefix)) {
+      QString relative = workdir.relativeFilePath(path);
+      if (relative.isEmpty() || relative == ".") {
+        mRescan = true;
+      } else {
+        mPaths.insert(relative);
+      }
+
+      changed = true;
+      continue;
+    }
+
+    // Classify changes in the git dir. Anything else
+    // in the git dir (objects, logs, locks) is ignored.
+    QString relative = dir.relativeFilePath(path);
+    if (relative == "HEAD") {
+      mHead = true;
+    } else if (relative == "index") {
+      mIndex = true;
+    } else if (relative == "packed-refs") {
+      mPackedRefs = true;
+    } else if (relative.startsWith("refs/") && !relative.endsWith(".lock")) {
+      if (QFileInfo(path).isDir())
+        continue;
+      mRefs.insert(relative);
+    } else if (kStateFiles.contains(relative.section('/', 0, 0))) {
+      mState = true;
+    } else {
+      continue;
+    }
+
+    changed = true;
+  }
+
+  if (changed)
+    mTimer.start();
 }
@@ -12,6 +12,7 @@
 
 #include "git/Repository.h"
 #include <QObject>
+#include <QSet>
 #include <QTimer>
 
 class RepositoryWatcherPrivate;
@@ -26,7 +27,21 @@ public:
   void cancelPendingNotification();
 
 private:
+  // Collect changed absolute paths until the timer fires and classify
+  // them by location. An empty list means that anything may have changed.
+  void notify(const QStringList &paths);
+
+  git::Repository mRepo;
+
   QTimer mTimer;
+  QSet<QString> mPaths;
+  QSet<QString> mRefs;
+  bool mPackedRefs = false;
+  bool mHead = false;
+  bool mIndex = false;
+  bool mState = false;
+  bool mRescan = false;
+
   RepositoryWatcherPrivate *d;
 };
 
@@ -8,14 +8,33 @@
 //
 
 #include "RepositoryWatcher.h"
-#include <QMap>
+#include "conf/Settings.h"
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QRunnable>
+#include <QSharedPointer>
 #include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <errno.h>
 #include <poll.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/inotify.h>
 
+Q_LOGGING_CATEGORY(lcWatcher, "gitahead.watcher")
+
 namespace {
 
+const int kBatchSize = 1024;
+
+const QString kIntervalKey = "global/watcher/interval";
+
 const uint kFlags =
   (IN_ATTRIB |
    IN_CLOSE_WRITE |
@@ -23,6 +42,8 @@ const uint kFlags =
    IN_DELETE |
    IN_DELETE_SELF |
    IN_MODIFY |
+   IN_MOVED_FROM |
+   IN_MOVED_TO |
    IN_MOVE_SELF);
 
 // FIXME: Include hidden and filter .git explicitly?
@@ -30,63 +51,414 @@ const QDir::Filters kFilters =
   (QDir::Dirs |
    QDir::NoDotAndDotDot);
 
+const QDir::Filters kPollFilters =
+  (QDir::AllEntries |
+   QDir::Hidden |
+   QDir::NoDotAndDotDot);
+
+// Map path to modification time and size.
+typedef QHash<QString,QPair<qint64,qint64>> Snapshot;
+
 } // anon. namespace
 
-class RepositoryWatcherPrivate : public QThread
+class RepositoryWatcherPrivate : public QObject
 {
   Q_OBJECT
 
 public:
   RepositoryWatcherPrivate(
     const git::Repository &repo,
-    QObject *parent = nullptr)
-    : QThread(parent), mRepo(repo)
+    QObject *parent = nullptr);
+  ~RepositoryWatcherPrivate() override;
+
+signals:
+  void notificationReceived(const QStringList &paths);
+};
+
+namespace {
+
+// The per-repository state is shared with the service thread.
+struct Client
+{
+  git::Repository repo;
+  QDir workdir;
+  QDir gitdir;
+  int interval;
+
+  // Set when the repository closes to stop walking it.
+  QAtomicInt closed;
+
+  // Polling fallback state.
+  bool polling = false;
+  bool scanned = false;
+  QElapsedTimer elapsed;
+  Snapshot snapshot;
+
+  bool isGitPath(const QString &path) const
   {
-    mFd = inotify_init1(IN_NONBLOCK);
-    if (mFd < 0)
-      return; // FIXME: Report error?
+    QString dir = gitdir.path();
+    return (path == dir || path.startsWith(dir + '/'));
+  }
+
+  // Paths in the git dir aren't subject to ignore rules.
+  bool isIgnored(const QString &path) const
+  {
+    return !isGitPath(path) && repo.isIgnored(path);
+  }
+};
+
+typedef QSharedPointer<Client> ClientPtr;
 
-    if (pipe(mPipe) < 0) {
-      // FIXME: Report error?
-      close(mFd);
-      mFd = -1;
+// Collect non-ignored directories. Ignored directories are pruned
+// with their whole subtree, so each one is only evaluated once.
+class DirectoryWalker
+{
+public:
+  DirectoryWalker(const Client &client, const QString &root)
+    : mClient(client)
+  {
+    mQueue.append(root);
+    mDirs.append(root);
+  }
+
+  // Walk on the calling thread plus a worker per extra core.
+  QStringList walk(bool parallel = false)
+  {
+    QThreadPool pool;
+    int count = parallel ? QThread::idealThreadCount() - 1 : 0;
+    for (int i = 0; i < count; ++i)
+      pool.start(new Worker(this));
+
+    work();
+    pool.waitForDone();
+    return mDirs;
+  }
+
+private:
+  class Worker : public QRunnable
+  {
+  public:
+    Worker(DirectoryWalker *walker)
+      : mWalker(walker)
+    {}
+
+    void run() override
+    {
+      mWalker->work();
+    }
+
+  private:
+    DirectoryWalker *mWalker;
+  };
+
+  void work()
+  {
+    QMutexLocker locker(&mLock);
+    forever {
+      // Wait until there's more work or everyone is done.
+      while (mQueue.isEmpty() && mActive > 0)
+        mCondition.wait(&mLock);
+
+      if (mQueue.isEmpty() || mClient.closed.loadAcquire())
+        break;
+
+      QDir dir(mQueue.takeLast());
+      ++mActive;
+      locker.unlock();
+
+      QStringList subdirs;
+      foreach (const QString &name, dir.entryList(kFilters)) {
+        QString path = dir.filePath(name);
+        if (!mClient.isIgnored(path))
+          subdirs.append(path);
+      }
+
+      locker.relock();
+      mQueue.append(subdirs);
+      mDirs.append(subdirs);
+      if (--mActive == 0 || !subdirs.isEmpty())
+        mCondition.wakeAll();
     }
   }
 
-  ~RepositoryWatcherPrivate()
+  const Client &mClient;
+
+  QMutex mLock;
+  QWaitCondition mCondition;
+  QStringList mQueue;
+  QStringList mDirs;
+  int mActive = 0;
+};
+
+// Map watcher to the directory that it watches through a descriptor.
+typedef QHash<RepositoryWatcherPrivate *,QDir> Watch;
+
+// One inotify thread multiplexes all open repositories. Directories
+// that are shared between repositories (e.g. submodules) are watched
+// once. Repositories fall back to polling when the watch limit is hit.
+// Initial walks run on a separate pool so that opening a large
+// repository doesn't hold up events for the others.
+class WatcherService : public QThread
+{
+public:
+  ~WatcherService() override
   {
+    {
+      QMutexLocker locker(&mLock);
+      foreach (const ClientPtr &client, mClients)
+        client->closed.storeRelease(1);
+    }
+
+    mPool.waitForDone();
+
+    if (isRunning()) {
+      post('q');
+      wait();
+    }
+
     close(mPipe[1]);
     close(mPipe[0]);
     close(mFd);
   }
 
-  bool isValid() const { return (mFd >= 0); }
+  void add(RepositoryWatcherPrivate *watcher, const ClientPtr &client)
+  {
+    if (mPipe[0] < 0)
+      return; // FIXME: Report error?
 
-  void run() override
+    QMutexLocker locker(&mLock);
+    mClients.insert(watcher, client);
+
+    // The thread keeps running until exit once it's started.
+    if (!isRunning())
+      start();
+
+    if (mFd < 0) {
+      startPolling(watcher, client);
+      return;
+    }
+
+    mPool.start(new InitialWalk(this, watcher, client));
+  }
+
+  // Don't wait for anything here. This is called on the main thread.
+  void remove(RepositoryWatcherPrivate *watcher)
   {
-    // Watch the root directory.
-    watch(mRepo.workdir());
+    QMutexLocker locker(&mLock);
+    ClientPtr client = mClients.take(watcher);
+    if (!client)
+      return;
 
-    // Start listening for notifications.
+    client->closed.storeRelease(1);
+    unwatch(watcher);
+  }
+
+  void run() override
+  {
     forever {
       pollfd pollFds[2];
       pollFds[0].fd = mPipe[0];
       pollFds[0].events = POLLIN;
       pollFds[1].fd = mFd;
       pollFds[1].events = POLLIN;
-      if (poll(pollFds, 2, -1) < 0)
+      if (poll(pollFds, 2, timeout()) < 0) {
+        if (errno == EINTR)
+          continue;
+
         return; // FIXME: Report error?
+      }
 
       // Check for signal to quit.
-      if (pollFds[0].revents & POLLIN)
-        return;
+      if (pollFds[0].revents & POLLIN) {
+        char buf[64];
+        int len = read(mPipe[0], buf, sizeof(buf));
+        if (len > 0 && memchr(buf, 'q', len))
+          return;
+      }
 
       // Check for notifications.
-      if (!(pollFds[1].revents & POLLIN))
+      if (pollFds[1].revents & POLLIN)
+        readEvents();
+
+      // Check for polled changes.
+      pollClients();
+    }
+  }
+
+  static WatcherService *instance()
+  {
+    static WatcherService service;
+    return &service;
+  }
+
+private:
+  class InitialWalk : public QRunnable
+  {
+  public:
+    InitialWalk(
+      WatcherService *service,
+      RepositoryWatcherPrivate *watcher,
+      const ClientPtr &client)
+      : mService(service), mWatcher(watcher), mClient(client)
+    {}
+
+    void run() override
+    {
+      mService->watch(mWatcher, mClient);
+    }
+
+  private:
+    WatcherService *mService;
+    RepositoryWatcherPrivate *mWatcher;
+    ClientPtr mClient;
+  };
+
+  WatcherService()
+  {
+    if (pipe(mPipe) < 0)
+      return; // FIXME: Report error?
+
+    // Poll everything if inotify isn't available.
+    mFd = inotify_init1(IN_NONBLOCK);
+  }
+
+  void post(char message)
+  {
+    if (write(mPipe[1], &message, 1) < 0)
+      terminate(); // FIXME: Report error?
+  }
+
+  // Start watching a new repository. Called on the pool.
+  void watch(RepositoryWatcherPrivate *watcher, const ClientPtr &client)
+  {
+    QElapsedTimer timer;
+    timer.start();
+    int count = watch(watcher, client, client->workdir.path(), true);
+
+    // Watch the git dir for HEAD, index and state changes and refs.
+    count += add(watcher, client, {client->gitdir.path()});
+    count += watch(watcher, client, client->gitdir.filePath("refs"));
+
+    qCDebug(lcWatcher) << "watched" << count << "directories under" <<
+      client->workdir.path() << "in" << timer.elapsed() << "ms";
+  }
+
+  // Watch the directory and its non-ignored subdirs.
+  // Return the number of directories that were watched.
+  int watch(
+    RepositoryWatcherPrivate *watcher,
+    const ClientPtr &client,
+    const QString &dir,
+    bool parallel = false)
+  {
+    QElapsedTimer timer;
+    timer.start();
+    QStringList dirs = DirectoryWalker(*client, dir).walk(parallel);
+    if (parallel)
+      qCDebug(lcWatcher) << "walked" << dirs.size() << "directories under" <<
+        dir << "in" << timer.elapsed() << "ms";
+
+    return add(watcher, client, dirs);
+  }
+
+  // Register watches in batches. Return the number of directories
+  // that were watched before the repository was closed or fell back.
+  int add(
+    RepositoryWatcherPrivate *watcher,
+    const ClientPtr &client,
+    const QStringList &dirs)
+  {
+    // Register in batches to avoid holding the lock for long.
+    for (int i = 0; i < dirs.size(); i += kBatchSize) {
+      QMutexLocker locker(&mLock);
+      if (mClients.value(watcher) != client || client->polling)
+        return i;
+
+      int end = qMin(i + kBatchSize, dirs.size());
+      for (int j = i; j < end; ++j) {
+        // Watching the same directory again returns the same descriptor.
+        const QString &path = dirs.at(j);
+        int wd = inotify_add_watch(mFd, path.toUtf8(), kFlags);
+        if (wd < 0) {
+          // The watch limit is exhausted.
+          if (errno == ENOSPC) {
+            qCDebug(lcWatcher) << "watch limit reached, polling" <<
+              client->workdir.path();
+            startPolling(watcher, client);
+            return j;
+          }
+
+          continue; // FIXME: Report other errors?
+        }
+
+        // Associate the dir with this watch descriptor.
+        mWatches[wd].insert(watcher, path);
+      }
+    }
+
+    return dirs.size();
+  }
+
+  // The caller must hold the lock.
+  void unwatch(RepositoryWatcherPrivate *watcher)
+  {
+    QMutableHashIterator<int,Watch> it(mWatches);
+    while (it.hasNext()) {
+      it.next();
+      it.value().remove(watcher);
+      if (it.value().isEmpty()) {
+        inotify_rm_watch(mFd, it.key());
+        it.remove();
+      }
+    }
+  }
+
+  // Remove the watches of the directory and its subdirs.
+  // The caller must hold the lock.
+  void unwatch(RepositoryWatcherPrivate *watcher, const QString &dir)
+  {
+    QString prefix = dir + '/';
+    QMutableHashIterator<int,Watch> it(mWatches);
+    while (it.hasNext()) {
+      it.next();
+      if (!it.value().contains(watcher))
+        continue;
+
+      QString path = it.value().value(watcher).path();
+      if (path != dir && !path.startsWith(prefix))
         continue;
 
-      // Read notifications.
-      bool ignored = true;
+      it.value().remove(watcher);
+      if (it.value().isEmpty()) {
+        inotify_rm_watch(mFd, it.key());
+        it.remove();
+      }
+    }
+  }
+
+  // The caller must hold the lock.
+  void startPolling(RepositoryWatcherPrivate *watcher, const ClientPtr &client)
+  {
+    unwatch(watcher);
+    client->polling = true;
+    client->scanned = false;
+    client->elapsed.start();
+
+    // Changes may have been missed while watching.
+    emit watcher->notificationReceived(QStringList());
+
+    // Wake up the thread to schedule the first poll.
+    post('w');
+  }
+
+  void readEvents()
+  {
+    QList<QPair<RepositoryWatcherPrivate *,QString>> dirs;
+
+    {
+      QMutexLocker locker(&mLock);
+      QSet<RepositoryWatcherPrivate *> rescan;
+      QHash<RepositoryWatcherPrivate *,QStringList> paths;
       forever {
         char buf[4096];
         int len = read(mFd, buf, sizeof(buf));
@@ -97,58 +469,183 @@ public:
         for (char *ptr = buf; ptr < buf + len;
              ptr += sizeof(inotify_event) + event->len) {
           event = reinterpret_cast<inotify_event *>(ptr);
-          if (event->len) {
-            QString path = mWds.value(event->wd).filePath(event->name);
-            if (!mRepo.isIgnored(path)) {
-              ignored = false;
-
-              // Start watching new directories.
-              int mask = (IN_CREATE | IN_ISDIR);
-              if ((event->mask & mask) == mask)
-                watch(path);
-            }
+
+          // Events were dropped. Anything may have changed.
+          if (event->mask & IN_Q_OVERFLOW) {
+            foreach (RepositoryWatcherPrivate *watcher, mClients.keys())
+              rescan.insert(watcher);
+          }
+
+          // The directory was removed.
+          if (event->mask & IN_IGNORED) {
+            mWatches.remove(event->wd);
+            continue;
+          }
+
+          if (!event->len)
+            continue;
+
+          Watch entry = mWatches.value(event->wd);
+          for (auto it = entry.begin(), end = entry.end(); it != end; ++it) {
+            ClientPtr client = mClients.value(it.key());
+            QString path = it.value().filePath(event->name);
+            if (client->isIgnored(path))
+              continue;
+
+            paths[it.key()].append(path);
+
+            // Stop watching directories that were moved away. Their
+            // watches would keep reporting under the old path.
+            if ((event->mask & IN_MOVED_FROM) && (event->mask & IN_ISDIR))
+              unwatch(it.key(), path);
+
+            // Start watching new directories, including directories
+            // moved into place. Only refs are watched in the git dir.
+            QString refs = client->gitdir.filePath("refs") + '/';
+            if ((event->mask & (IN_CREATE | IN_MOVED_TO)) &&
+                (event->mask & IN_ISDIR) &&
+                (!client->isGitPath(path) || path.startsWith(refs)))
+              dirs.append(qMakePair(it.key(), path));
           }
         }
       }
 
-      if (!ignored)
-        emit notificationReceived();
+      foreach (RepositoryWatcherPrivate *watcher, rescan)
+        emit watcher->notificationReceived(QStringList());
+
+      for (auto it = paths.begin(), end = paths.end(); it != end; ++it) {
+        if (!rescan.contains(it.key()))
+          emit it.key()->notificationReceived(it.value());
+      }
+    }
+
+    for (int i = 0; i < dirs.size(); ++i) {
+      RepositoryWatcherPrivate *watcher = dirs.at(i).first;
+      QMutexLocker locker(&mLock);
+      ClientPtr client = mClients.value(watcher);
+      locker.unlock();
+
+      if (client)
+        watch(watcher, client, dirs.at(i).second);
     }
   }
 
-  void watch(const QDir &dir)
+  // Get the time until the next poll is due.
+  int timeout()
   {
-    int wd = inotify_add_watch(mFd, dir.path().toUtf8(), kFlags);
-    if (wd < 0)
-      return; // FIXME: Report error?
-
-    // Associate the dir with this watch descriptor.
-    mWds[wd] = dir;
+    int result = -1;
+    QMutexLocker locker(&mLock);
+    foreach (const ClientPtr &client, mClients) {
+      if (!client->polling)
+        continue;
 
-    // Watch subdirs.
-    foreach (const QString &name, dir.entryList(kFilters)) {
-      QString path = dir.filePath(name);
-      if (!mRepo.isIgnored(path))
-        watch(path);
+      int remaining = 0;
+      if (client->scanned)
+        remaining = qMax(0, client->interval - int(client->elapsed.elapsed()));
+      if (result < 0 || remaining < result)
+        result = remaining;
     }
+
+    return result;
   }
 
-  void stop()
+  void pollClients()
   {
-    if (write(mPipe[1], "\n", 1) < 0)
-      terminate(); // FIXME: Report error?
+    QMutexLocker locker(&mLock);
+    QHash<RepositoryWatcherPrivate *,ClientPtr> clients = mClients;
+    locker.unlock();
+
+    for (auto it = clients.begin(), end = clients.end(); it != end; ++it) {
+      ClientPtr client = it.value();
+      if (!client->polling ||
+          (client->scanned && client->elapsed.elapsed() < client->interval))
+        continue;
+
+      Snapshot snapshot;
+      scan(*client, client->workdir, snapshot);
+      scan(*client, client->gitdir, snapshot, false);
+      scan(*client, client->gitdir.filePath("refs"), snapshot);
+
+      QStringList paths;
+      if (client->scanned) {
+        for (auto jt = snapshot.begin(), jend = snapshot.end();
+             jt != jend; ++jt) {
+          if (!client->snapshot.contains(jt.key()) ||
+              client->snapshot.value(jt.key()) != jt.value())
+            paths.append(jt.key());
+        }
+
+        for (auto jt = client->snapshot.begin(), jend = client->snapshot.end();
+             jt != jend; ++jt) {
+          if (!snapshot.contains(jt.key()))
+            paths.append(jt.key());
+        }
+      }
+
+      client->snapshot = snapshot;
+      client->scanned = true;
+      client->elapsed.start();
+
+      locker.relock();
+      if (mClients.value(it.key()) == client && !paths.isEmpty())
+        emit it.key()->notificationReceived(paths);
+      locker.unlock();
+    }
   }
 
-signals:
-  void notificationReceived();
+  void scan(
+    const Client &client,
+    const QDir &dir,
+    Snapshot &snapshot,
+    bool recursive = true)
+  {
+    foreach (const QFileInfo &info, dir.entryInfoList(kPollFilters)) {
+      // The git dir is scanned separately.
+      QString path = info.filePath();
+      if (path == client.gitdir.path() || client.isIgnored(path))
+        continue;
+
+      qint64 time = info.lastModified().toMSecsSinceEpoch();
+      snapshot.insert(path, qMakePair(time, info.size()));
+
+      if (recursive && info.isDir() && !info.isSymLink())
+        scan(client, path, snapshot);
+    }
+  }
 
-private:
-  git::Repository mRepo;
   int mFd = -1;
   int mPipe[2] = {-1, -1};
-  QMap<int,QDir> mWds;
+
+  QMutex mLock;
+  QHash<RepositoryWatcherPrivate *,ClientPtr> mClients;
+  QHash<int,Watch> mWatches;
+
+  QThreadPool mPool;
 };
 
+} // anon. namespace
+
+RepositoryWatcherPrivate::RepositoryWatcherPrivate(
+  const git::Repository &repo,
+  QObject *parent)
+  : QObject(parent)
+{
+  ClientPtr client(new Client);
+  client->repo = repo;
+  client->workdir = repo.workdir();
+  client->gitdir = repo.dir();
+
+  int seconds = Settings::instance()->value(kIntervalKey).toInt();
+  client->interval = qMax(1, seconds) * 1000;
+
+  WatcherService::instance()->add(this, client);
+}
+
+RepositoryWatcherPrivate::~RepositoryWatcherPrivate()
+{
+  WatcherService::instance()->remove(this);
+}
+
 RepositoryWatcher::RepositoryWatcher(
   const git::Repository &repo,
   QObject *parent)
@@ -156,18 +653,9 @@ RepositoryWatcher::RepositoryWatcher(
 {
   init(repo);
   connect(d, &RepositoryWatcherPrivate::notificationReceived,
-          &mTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
-
-  if (d->isValid())
-    d->start();
+          this, &RepositoryWatcher::notify);
 }
 
-RepositoryWatcher::~RepositoryWatcher()
-{
-  if (d->isValid()) {
-    d->stop();
-    d->wait();
-  }
-}
+RepositoryWatcher::~RepositoryWatcher() {}
 
 #include "RepositoryWatcher_linux.moc"
@@ -23,22 +23,37 @@ public:
     // Create dispatch queue.
     mQueue = dispatch_queue_create("com.gitahead.RepositoryWatcher", nullptr);
 
-    // Create stream to watch the workdir.
+    // Create stream to watch the workdir and the git dir. File
+    // events are needed to tell git dir changes apart.
     FSEventStreamContext context = { 0, this, nullptr, nullptr, nullptr };
 
-    CFStringRef wd = repo.workdir().path().toCFString();
-    CFArrayRef wds = CFArrayCreate(nullptr, (const void **) &wd, 1, nullptr);
+    QDir dir = repo.dir();
+    QString workdir = repo.workdir().path();
+    QStringList paths = {workdir};
+    if (!dir.path().startsWith(workdir + '/'))
+      paths.append(dir.path());
+
+    CFMutableArrayRef wds = CFArrayCreateMutable(
+      nullptr, paths.size(), &kCFTypeArrayCallBacks);
+    foreach (const QString &path, paths) {
+      CFStringRef wd = path.toCFString();
+      CFArrayAppendValue(wds, wd);
+      CFRelease(wd);
+    }
+
     mStream = FSEventStreamCreate(nullptr, &notify, &context, wds,
-      kFSEventStreamEventIdSinceNow, 0, kFSEventStreamCreateFlagNone);
+      kFSEventStreamEventIdSinceNow, 0, kFSEventStreamCreateFlagFileEvents);
     CFRelease(wds);
-    CFRelease(wd);
 
-    // Exclude the .git dir.
-    CFStringRef gd = repo.dir().path().toCFString();
-    CFArrayRef gds = CFArrayCreate(nullptr, (const void **) &gd, 1, nullptr);
+    // Exclude the parts of the git dir that aren't classified.
+    CFStringRef objects = dir.filePath("objects").toCFString();
+    CFStringRef logs = dir.filePath("logs").toCFString();
+    const void *exclusions[] = { objects, logs };
+    CFArrayRef gds = CFArrayCreate(nullptr, exclusions, 2, nullptr);
     FSEventStreamSetExclusionPaths(mStream, gds);
     CFRelease(gds);
-    CFRelease(gd);
+    CFRelease(logs);
+    CFRelease(objects);
 
     // Register with queue.
     FSEventStreamSetDispatchQueue(mStream, mQueue);
@@ -73,19 +88,35 @@ public:
     RepositoryWatcherPrivate *watcher =
       static_cast<RepositoryWatcherPrivate *>(clientCallBackInfo);
 
-    // Filter out ignored directories.
+    // Filter out ignored paths.
+    QStringList changed;
+    bool rescan = false;
     git::Repository repo = watcher->repo();
+    QString dir = repo.dir().path();
     const char **paths = static_cast<const char **>(eventPaths);
     for (int i = 0; i < numEvents; ++i) {
-      if (!repo.isIgnored(paths[i])) {
-        emit watcher->notificationReceived();
-        return;
-      }
+      // Events were coalesced above the changed paths.
+      if (eventFlags[i] & (kFSEventStreamEventFlagMustScanSubDirs |
+                           kFSEventStreamEventFlagKernelDropped |
+                           kFSEventStreamEventFlagUserDropped))
+        rescan = true;
+
+      // Changes in the git dir are classified by the watcher.
+      QString path = QString::fromUtf8(paths[i]);
+      bool git = (path == dir || path.startsWith(dir + '/'));
+      if (git || !repo.isIgnored(path))
+        changed.append(path);
+    }
+
+    if (rescan) {
+      emit watcher->notificationReceived(QStringList());
+    } else if (!changed.isEmpty()) {
+      emit watcher->notificationReceived(changed);
     }
   }
 
 signals:
-  void notificationReceived();
+  void notificationReceived(const QStringList &paths);
 
 private:
   git::Repository mRepo;
@@ -100,7 +131,7 @@ RepositoryWatcher::RepositoryWatcher(
 {
   init(repo);
   connect(d, &RepositoryWatcherPrivate::notificationReceived,
-          &mTimer, QOverload<>::of(&QTimer::start));
+          this, &RepositoryWatcher::notify);
 }
 
 RepositoryWatcher::~RepositoryWatcher() {}
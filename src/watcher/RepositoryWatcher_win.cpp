@@ -118,7 +118,9 @@ public:
     watcher->watch();
 
     // Iterate over notifications.
+    QStringList paths;
     git::Repository repo = watcher->repo();
+    QDir workdir = repo.workdir();
     const BYTE *ptr = buffer.constData();
     forever {
       const FILE_NOTIFY_INFORMATION *info =
@@ -127,20 +129,24 @@ public:
       int size = info->FileNameLength / sizeof(wchar_t);
       QString native = QString::fromWCharArray(info->FileName, size);
       QString path = QDir::fromNativeSeparators(native);
-      if (!path.isEmpty() && !repo.isIgnored(path)) {
-        emit watcher->notificationReceived();
-        return;
-      }
+
+      // Changes in the git dir are classified by the watcher.
+      bool git = (path == ".git" || path.startsWith(".git/"));
+      if (!path.isEmpty() && (git || !repo.isIgnored(path)))
+        paths.append(workdir.filePath(path));
 
       if (!info->NextEntryOffset)
-        return;
+        break;
 
       ptr += info->NextEntryOffset;
     }
+
+    if (!paths.isEmpty())
+      emit watcher->notificationReceived(paths);
   }
 
 signals:
-  void notificationReceived();
+  void notificationReceived(const QStringList &paths);
 
 private:
   git::Repository mRepo;
@@ -157,7 +163,7 @@ RepositoryWatcher::RepositoryWatcher(
 {
   init(repo);
   connect(d, &RepositoryWatcherPrivate::notificationReceived,
-          &mTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+          this, &RepositoryWatcher::notify);
 
   d->start();
 }
@@ -0,0 +1,67 @@
+//
+//          Copyright (c) 2016, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#include "Test.h"
+#include "git/Commit.h"
+#include "git/TagRef.h"
+
+using namespace Test;
+using namespace QTest;
+
+class TestCommit : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void description();
+  void emoji();
+
+private:
+  ScratchRepository mRepo;
+};
+
+void TestCommit::description()
+{
+  git::Commit first = mRepo->commit("first");
+  QVERIFY(first.isValid());
+  QVERIFY(first.description().isEmpty());
+
+  // Tag the first commit.
+  QVERIFY(mRepo->createTag(first, "v1.0").isValid());
+  QCOMPARE(first.description(), QString("v1.0"));
+
+  // Commits created after the index was built are resolved from parents.
+  git::Commit second = mRepo->commit("second");
+  git::Commit third = mRepo->commit("third");
+  QVERIFY(second.isValid() && third.isValid());
+  QCOMPARE(second.description(), QString("v1.0 +1"));
+  QCOMPARE(third.description(), QString("v1.0 +2"));
+
+  // Adding a tag invalidates the index.
+  QVERIFY(mRepo->createTag(second, "v2.0").isValid());
+  QCOMPARE(third.description(), QString("v2.0 +1"));
+  QCOMPARE(first.description(), QString("v1.0"));
+}
+
+void TestCommit::emoji()
+{
+  git::Commit commit = mRepo->commit(":smile: a:b:+1: :unknown: 10:30 :");
+  QVERIFY(commit.isValid());
+
+  QString summary = commit.summary(git::Commit::SubstituteEmoji);
+  QCOMPARE(summary, QString::fromUtf8("😄 a:b👍 :unknown: 10:30 :"));
+
+  // Text without shortcodes is unchanged.
+  commit = mRepo->commit("no shortcodes");
+  QCOMPARE(commit.summary(git::Commit::SubstituteEmoji), commit.summary());
+}
+
+TEST_MAIN(TestCommit)
+
+#include "commit.moc"
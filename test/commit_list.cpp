@@ -0,0 +1,89 @@
+//
+//          Copyright (c) 2016, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#include "Test.h"
+#include "git/Commit.h"
+#include "ui/CommitList.h"
+#include "ui/MainWindow.h"
+#include "ui/RepoView.h"
+#include <QFile>
+#include <QTextStream>
+
+using namespace Test;
+using namespace QTest;
+
+namespace {
+
+// More than the first batch of rows.
+const int kCommitCount = 300;
+
+} // anon. namespace
+
+class TestCommitList : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void findUnloaded();
+  void cleanupTestCase();
+
+private:
+  ScratchRepository mRepo;
+  QList<git::Commit> mCommits;
+  MainWindow *mWindow = nullptr;
+};
+
+void TestCommitList::initTestCase()
+{
+  for (int i = 0; i < kCommitCount; ++i) {
+    git::Commit commit = mRepo->commit(QString("commit %1").arg(i));
+    QVERIFY(commit.isValid());
+    mCommits.prepend(commit);
+  }
+
+  // Add an untracked file so that the list starts with the status row.
+  QFile file(mRepo->workdir().filePath("dirty"));
+  QVERIFY(file.open(QFile::WriteOnly));
+  QTextStream(&file) << "This is a test." << endl;
+  file.close();
+
+  mWindow = new MainWindow(mRepo);
+  mWindow->show();
+  QVERIFY(qWaitForWindowActive(mWindow));
+
+  refresh(mWindow->currentView());
+}
+
+void TestCommitList::findUnloaded()
+{
+  CommitList *list = mWindow->currentView()->commitList();
+  QAbstractItemModel *model = list->model();
+  int loaded = model->rowCount() - 1;
+  QVERIFY(loaded < kCommitCount);
+
+  // Select the first commit that isn't loaded yet and one beyond it.
+  for (int i : {loaded, loaded + 10}) {
+    git::Commit commit = mCommits.at(i);
+    QVERIFY(list->selectRange(commit.id().toString()));
+
+    QList<git::Commit> selected = list->selectedCommits();
+    QCOMPARE(selected.size(), 1);
+    QVERIFY(selected.first() == commit);
+  }
+}
+
+void TestCommitList::cleanupTestCase()
+{
+  mWindow->close();
+}
+
+TEST_MAIN(TestCommitList)
+
+#include "commit_list.moc"
@@ -0,0 +1,119 @@
+//
+//          Copyright (c) 2016, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#include "Test.h"
+#include "git/Diff.h"
+#include "git/Index.h"
+#include <QFile>
+#include <QTextStream>
+
+using namespace Test;
+using namespace QTest;
+
+namespace {
+
+const int kDirCount = 64;
+const int kFileCount = 128;
+
+bool write(const QString &path, const QString &text)
+{
+  QFile file(path);
+  if (!file.open(QFile::WriteOnly))
+    return false;
+
+  QTextStream(&file) << text << endl;
+  return true;
+}
+
+} // anon. namespace
+
+class TestStatus : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void parallelMatchesSerial();
+  void serial();
+  void parallel();
+
+private:
+  ScratchRepository mRepo;
+};
+
+void TestStatus::initTestCase()
+{
+  // Add a large tree of files.
+  QDir dir = mRepo->workdir();
+  QStringList files;
+  for (int i = 0; i < kDirCount; ++i) {
+    QString name = QString("dir%1").arg(i);
+    QVERIFY(dir.mkpath(name));
+    for (int j = 0; j < kFileCount; ++j) {
+      QString file = QString("%1/file%2").arg(name).arg(j);
+      QVERIFY(write(dir.filePath(file), file));
+      files.append(file);
+    }
+  }
+
+  QVERIFY(write(dir.filePath("root"), "root"));
+  files.append("root");
+
+  git::Index index = mRepo->index();
+  index.setStaged(files, true);
+
+  // Modify, delete and add files across directories.
+  for (int i = 0; i < kDirCount; i += 3) {
+    QString name = QString("dir%1").arg(i);
+    QVERIFY(write(dir.filePath(name + "/file0"), "modified"));
+    QVERIFY(dir.remove(name + "/file1"));
+    QVERIFY(write(dir.filePath(name + "/untracked"), "untracked"));
+  }
+
+  QVERIFY(dir.mkpath("new"));
+  QVERIFY(write(dir.filePath("new/file"), "new"));
+  QVERIFY(write(dir.filePath("root"), "modified"));
+}
+
+void TestStatus::parallelMatchesSerial()
+{
+  git::Index index = mRepo->index();
+  git::Diff serial = mRepo->diffIndexToWorkdir(index, nullptr, {}, 1);
+  git::Diff parallel = mRepo->diffIndexToWorkdir(index, nullptr, {}, 4);
+  QVERIFY(serial.isValid());
+  QVERIFY(parallel.isValid());
+
+  // Three changes in each of 22 dirs plus the new dir and the root file.
+  QCOMPARE(serial.count(), 3 * ((kDirCount + 2) / 3) + 2);
+  QCOMPARE(parallel.count(), serial.count());
+  for (int i = 0; i < serial.count(); ++i) {
+    QCOMPARE(parallel.name(i), serial.name(i));
+    QCOMPARE(parallel.status(i), serial.status(i));
+  }
+}
+
+void TestStatus::serial()
+{
+  git::Index index = mRepo->index();
+  QBENCHMARK {
+    mRepo->diffIndexToWorkdir(index, nullptr, {}, 1);
+  }
+}
+
+void TestStatus::parallel()
+{
+  git::Index index = mRepo->index();
+  QBENCHMARK {
+    mRepo->diffIndexToWorkdir(index, nullptr, {}, 0);
+  }
+}
+
+TEST_MAIN(TestStatus)
+
+#include "status.moc"
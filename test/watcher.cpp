@@ -0,0 +1,106 @@
+//
+//          Copyright (c) 2017, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#include "Test.h"
+#include "watcher/RepositoryWatcher.h"
+#include <QFile>
+#include <QTextStream>
+
+using namespace Test;
+using namespace QTest;
+
+namespace {
+
+// The watcher reports after its timer fires.
+const int kTimeout = 5000; // ms
+
+// Write the file next to the target and rename it into place.
+bool replace(const QString &path, const QString &text, const QString &tmp)
+{
+  QFile file(tmp);
+  if (!file.open(QFile::WriteOnly))
+    return false;
+
+  QTextStream(&file) << text;
+  file.close();
+
+  QFile::remove(path);
+  return QFile::rename(tmp, path);
+}
+
+} // anon. namespace
+
+class TestWatcher : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void renameIndex();
+  void renameHead();
+  void atomicSave();
+  void cleanupTestCase();
+
+private:
+  ScratchRepository mRepo;
+  RepositoryWatcher *mWatcher = nullptr;
+};
+
+void TestWatcher::initTestCase()
+{
+  mWatcher = new RepositoryWatcher(mRepo);
+
+  // Give the initial walk time to register the watches.
+  qWait(500);
+}
+
+void TestWatcher::renameIndex()
+{
+  git::RepositoryNotifier *notifier = mRepo->notifier();
+  QSignalSpy spy(notifier, &git::RepositoryNotifier::indexRewritten);
+
+  // Git writes the index to a lock file and renames it into place.
+  QString path = mRepo->dir().filePath("index");
+  QVERIFY(replace(path, "index", path + ".lock"));
+  QTRY_VERIFY_WITH_TIMEOUT(spy.count() > 0, kTimeout);
+}
+
+void TestWatcher::renameHead()
+{
+  git::RepositoryNotifier *notifier = mRepo->notifier();
+  QSignalSpy spy(notifier, &git::RepositoryNotifier::referenceUpdated);
+
+  QString path = mRepo->dir().filePath("HEAD");
+  QString text = "ref: refs/heads/master\n";
+  QVERIFY(replace(path, text, path + ".lock"));
+  QTRY_VERIFY_WITH_TIMEOUT(spy.count() > 0, kTimeout);
+}
+
+void TestWatcher::atomicSave()
+{
+  git::RepositoryNotifier *notifier = mRepo->notifier();
+  QSignalSpy spy(notifier, &git::RepositoryNotifier::workdirChanged);
+
+  // Editors write a temporary file and rename it over the target.
+  QString path = mRepo->workdir().filePath("file");
+  QVERIFY(replace(path, "saved\n", path + ".tmp"));
+  QTRY_VERIFY_WITH_TIMEOUT(spy.count() > 0, kTimeout);
+
+  QStringList paths = spy.last().first().toStringList();
+  QVERIFY(paths.contains("file"));
+}
+
+void TestWatcher::cleanupTestCase()
+{
+  delete mWatcher;
+}
+
+TEST_MAIN(TestWatcher)
+
+#include "watcher.moc"
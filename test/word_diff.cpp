@@ -0,0 +1,83 @@
+//
+//          Copyright (c) 2016, Scientific Toolworks, Inc.
+//
+// This software is licensed under the MIT License. The LICENSE.md file
+// describes the conditions under which this software may be distributed.
+//
+// Author: Jason Haslam
+//
+
+#include "Test.h"
+#include "ui/WordDiff.h"
+
+using namespace QTest;
+
+namespace {
+
+const QByteArray kWordChars =
+  "_0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+const QByteArray kWhitespaceChars = " \t";
+
+} // anon. namespace
+
+class TestWordDiff : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void tokenize();
+  void diff();
+  void ranges();
+};
+
+void TestWordDiff::tokenize()
+{
+  WordDiff words(kWordChars, kWhitespaceChars);
+  QCOMPARE(words.tokenize(""), QVector<int>({0}));
+  QCOMPARE(words.tokenize("int x  = y;"),
+           QVector<int>({0, 3, 4, 5, 7, 8, 9, 10, 11}));
+}
+
+void TestWordDiff::diff()
+{
+  // Identical sequences.
+  QVERIFY(WordDiff::diff({1, 2, 3}, {1, 2, 3}).isEmpty());
+
+  // Replace the middle token.
+  QList<WordDiff::Edit> edits = WordDiff::diff({1, 2, 3}, {1, 4, 3});
+  QCOMPARE(edits.size(), 1);
+  QCOMPARE(edits.first().oldBegin, 1);
+  QCOMPARE(edits.first().oldEnd, 2);
+  QCOMPARE(edits.first().newBegin, 1);
+  QCOMPARE(edits.first().newEnd, 2);
+
+  // Separate insertion and deletion.
+  edits = WordDiff::diff({1, 2, 3, 4, 5}, {1, 3, 4, 6, 5});
+  QCOMPARE(edits.size(), 2);
+  QCOMPARE(edits.at(0).oldBegin, 1);
+  QCOMPARE(edits.at(0).oldEnd, 2);
+  QCOMPARE(edits.at(0).newBegin, 1);
+  QCOMPARE(edits.at(0).newEnd, 1);
+  QCOMPARE(edits.at(1).oldBegin, 4);
+  QCOMPARE(edits.at(1).oldEnd, 4);
+  QCOMPARE(edits.at(1).newBegin, 3);
+  QCOMPARE(edits.at(1).newEnd, 4);
+}
+
+void TestWordDiff::ranges()
+{
+  WordDiff words(kWordChars, kWhitespaceChars);
+  words.addLines({10, "int x = y;"}, {30, "int x = z;"});
+
+  WordDiff::Ranges ranges = words.ranges();
+  QCOMPARE(ranges.deletions.size(), 1);
+  QCOMPARE(ranges.deletions.first().pos, 18);
+  QCOMPARE(ranges.deletions.first().length, 1);
+  QCOMPARE(ranges.additions.size(), 1);
+  QCOMPARE(ranges.additions.first().pos, 38);
+  QCOMPARE(ranges.additions.first().length, 1);
+}
+
+TEST_MAIN(TestWordDiff)
+
+#include "word_diff.moc"